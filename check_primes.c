@@ -0,0 +1,2440 @@
+#define _XOPEN_SOURCE 700
+
+#include "primes.h"
+#include "small_primes.h"
+#include "hash_store.h"
+#include "stats.h"
+#include "server.h"
+#include "client.h"
+
+#include <check.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/*
+* Checks run in a temporary working directory, so cache files of each run start empty.
+*/
+#define CHECK_DIRECTORY_TEMPLATE "/tmp/check_primes.XXXXXX"
+
+/*
+* First number of the second cache file.
+*/
+#define FILE_BOUNDARY (MAX_FILE_SIZE * 8)
+
+/*
+* Numbers covered by a segment of the range engine (16 pages of the cache).
+*/
+#define SEGMENT_NUMBERS (16 * sysconf(_SC_PAGESIZE) * 8)
+
+#define RANGE_CALLERS 4
+#define BUDGET_PAGES 4
+#define SPARSE_QUERIES 16
+#define CHECK_SOCKET "check.sock"
+
+/*
+* Range collected by one of several threads calling the range engine at once.
+*/
+typedef struct range_call
+{
+    size_t    begin;
+    size_t    end;
+    dynarr_t  *primes;
+}
+range_call_t;
+
+/*
+* Matches of a pattern search collected by `collect_match`, the search stops after `limit` of them.
+*/
+typedef struct match_list
+{
+    size_t    limit;
+    dynarr_t  *primes;
+    dynarr_t  *widths;
+}
+match_list_t;
+
+/*
+* Deterministic Miller-Rabin test for 64-bit numbers, reference the cache is compared with.
+*/
+static bool is_prime_reference(size_t number);
+
+/*
+* Compares `is_prime_cached` with the reference for every number of [begin, end].
+*/
+static void check_cached_range(size_t begin, size_t end);
+
+/*
+* A verdict of the filter has to agree with the reference, only numbers past the square
+* of the largest small prime may stay undefined.
+*/
+static void check_filtered(size_t number, cache_value_t value);
+
+/*
+* Compares `are_primes_cached` with the reference for `count` consecutive numbers from `first` on,
+* in batches of growing size.
+*/
+static void check_cached_batches(size_t first, size_t count);
+
+/*
+* Medium range primitive root of a small `prime` by brute force: middle one of its roots
+* in ascending order, zero if there are none.
+*/
+static size_t medium_range_proot_reference(size_t prime);
+
+/*
+* Multiplicative order of `number` modulo a small `prime`.
+*/
+static size_t order_reference(size_t number, size_t prime);
+
+/*
+* Marks a visited root in the bitmap `param`, `param[0]` counts visits and stops the walk at 10
+* when it is negative.
+*/
+static bool mark_visited_root(size_t root, void *param);
+
+/*
+* Checks that `primes` holds exactly the primes of [begin, end] in ascending order.
+*/
+static void check_primes_array(const dynarr_t *primes, size_t begin, size_t end);
+
+/*
+* Collects primes of the `range_call_t` given by `param` with two workers.
+*/
+static void *call_range_engine(void *param);
+
+/*
+* Checks `next_prime` and `prev_prime` of numbers in [begin, end) against the reference.
+*/
+static void check_navigation(size_t begin, size_t end);
+
+/*
+* Looks up the first prime of the range engine segment `segment`, so the cache opens its page.
+*/
+static void touch_segment(size_t segment);
+
+/*
+* Waits until the read-ahead worker prepared `count` segments since the last reset of statistics.
+*/
+static void wait_read_ahead(size_t count);
+
+/*
+* Smallest prime not below `number`, by the reference.
+*/
+static size_t reference_prime_from(size_t number);
+
+/*
+* Amount of primes within [begin, end] by the reference.
+*/
+static size_t count_reference(size_t begin, size_t end);
+
+/*
+* Checks rank and select of a view of [begin, end] for every number of it against the reference.
+*/
+static void check_view(size_t begin, size_t end);
+
+/*
+* Appends a match of a pattern search to the `match_list_t` given by `param`.
+*/
+static bool collect_match(size_t prime, size_t width, void *param);
+
+/*
+* Checks matches of `find_prime_tuples` within [begin, end] against the reference,
+* the search is stopped after `limit` matches.
+*/
+static void check_tuples(size_t begin, size_t end, const size_t *offsets, size_t count, size_t limit);
+
+/*
+* Checks matches of `find_prime_gaps` within [begin, end] against the reference,
+* the search is stopped after `limit` matches.
+*/
+static void check_gaps(size_t begin, size_t end, size_t min_gap, size_t limit);
+
+/*
+* Adds to counters of a thread of its own, which is retired when it returns.
+*/
+static void *add_thread_stats(void *param);
+
+/*
+* Runs the daemon server on CHECK_SOCKET until `server_stop`.
+*/
+static void *run_server(void *param);
+
+/*
+* Connects to the server started by `run_server`, waits for it to listen first.
+*/
+static void connect_server(client_t *client);
+
+/*
+* Sends a request as is and reads the header of its response, payload is left in the socket.
+*/
+static proto_response_t exchange_raw(client_t *client, proto_op_t op, const uint64_t *payload, size_t count);
+
+static void setup_cache(void);
+static void teardown_cache(void);
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw);
+
+static Suite *l1_cache_suite(void);
+static Suite *small_primes_suite(void);
+static Suite *pmpr_suite(void);
+static Suite *hash_store_suite(void);
+static Suite *range_suite(void);
+static Suite *stats_suite(void);
+static Suite *protocol_suite(void);
+static Suite *reader_suite(void);
+static Suite *cold_store_suite(void);
+static Suite *navigation_suite(void);
+static Suite *miss_policy_suite(void);
+static Suite *read_ahead_suite(void);
+static Suite *mem_budget_suite(void);
+static Suite *extents_suite(void);
+static Suite *sparse_suite(void);
+static Suite *count_suite(void);
+static Suite *view_suite(void);
+static Suite *patterns_suite(void);
+
+
+int main(void)
+{
+    char directory[] = CHECK_DIRECTORY_TEMPLATE;
+    if (NULL == mkdtemp(directory) || -1 == chdir(directory)) return EXIT_FAILURE;
+
+    SRunner *runner = srunner_create(l1_cache_suite());
+    srunner_add_suite(runner, small_primes_suite());
+    srunner_add_suite(runner, pmpr_suite());
+    srunner_add_suite(runner, hash_store_suite());
+    srunner_add_suite(runner, range_suite());
+    srunner_add_suite(runner, stats_suite());
+    srunner_add_suite(runner, protocol_suite());
+    srunner_add_suite(runner, reader_suite());
+    srunner_add_suite(runner, cold_store_suite());
+    srunner_add_suite(runner, navigation_suite());
+    srunner_add_suite(runner, miss_policy_suite());
+    srunner_add_suite(runner, read_ahead_suite());
+    srunner_add_suite(runner, mem_budget_suite());
+    srunner_add_suite(runner, extents_suite());
+    srunner_add_suite(runner, sparse_suite());
+    srunner_add_suite(runner, count_suite());
+    srunner_add_suite(runner, view_suite());
+    srunner_add_suite(runner, patterns_suite());
+
+    srunner_run_all(runner, CK_NORMAL);
+    int failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    nftw(directory, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+START_TEST(l1_small_numbers)
+{
+    check_cached_range(0, 100000);
+}
+END_TEST
+
+
+START_TEST(l1_limit_boundary)
+{
+    /* last numbers answered by the bitset and first ones answered by the cache files */
+    check_cached_range(L1_CACHE_LIMIT - 2000, L1_CACHE_LIMIT + 2000);
+}
+END_TEST
+
+
+START_TEST(l1_matches_trial_division)
+{
+    for (size_t number = 0; number < 20000; ++number)
+    {
+        ck_assert_int_eq(is_prime(number), is_prime_reference(number));
+    }
+}
+END_TEST
+
+
+static Suite *l1_cache_suite(void)
+{
+    Suite *suite = suite_create("l1_cache");
+    TCase *tcase = tcase_create("lookup");
+
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, l1_small_numbers);
+    tcase_add_test(tcase, l1_limit_boundary);
+    tcase_add_test(tcase, l1_matches_trial_division);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(filter_small_numbers)
+{
+    for (size_t number = 1; number < 4 * SMALL_PRIMES_LARGEST * SMALL_PRIMES_LARGEST; number += 2)
+    {
+        check_filtered(number, small_primes_filter(number));
+    }
+}
+END_TEST
+
+
+START_TEST(filter_large_numbers)
+{
+    /* above 2^52 and next to 2^64, where the products wrap around */
+    for (size_t number = (1ul << 53) + 1; number < (1ul << 53) + 20000; number += 2)
+    {
+        check_filtered(number, small_primes_filter(number));
+    }
+    for (size_t number = -1ul; number > -1ul - 20000; number -= 2)
+    {
+        check_filtered(number, small_primes_filter(number));
+    }
+}
+END_TEST
+
+
+START_TEST(filter_batch_kernels)
+{
+    size_t numbers[64];
+    cache_value_t out[64];
+
+    /* small primes themselves, their products, survivors and numbers next to 2^64 */
+    for (size_t i = 0; i < 64; ++i)
+    {
+        static const size_t bases[] = { 1, SMALL_PRIMES_LARGEST - 40, 1ul << 53, -129ul };
+        numbers[i] = bases[i % 4] + 2 * (i / 4);
+    }
+
+    static const filter_kernel_t kernels[] = { FILTER_KERNEL_SCALAR, FILTER_KERNEL_AVX2, FILTER_KERNEL_AVX512 };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k)
+    {
+        if (!set_filter_kernel(kernels[k])) continue;
+
+        /* sizes which are not multiples of the vector width leave scalar tails */
+        for (size_t count = 0; count <= 64; ++count)
+        {
+            small_primes_filter_batch(numbers, count, out);
+            for (size_t i = 0; i < count; ++i)
+            {
+                ck_assert_msg(out[i] == small_primes_filter(numbers[i]),
+                    "kernel %d differs on %zu", kernels[k], numbers[i]);
+            }
+        }
+    }
+
+    init_small_primes();
+}
+END_TEST
+
+
+START_TEST(batch_cached_lookups)
+{
+    check_cached_batches(0, 300);
+    check_cached_batches(L1_CACHE_LIMIT - 301, 600);
+    check_cached_batches((1ul << 53) - 151, 300);
+}
+END_TEST
+
+
+START_TEST(tables_small_primes)
+{
+    const small_prime_t *primes = get_small_primes();
+    size_t expected = 3;
+
+    for (size_t i = 0; i < SMALL_PRIMES_COUNT; ++i, expected += 2)
+    {
+        while (!is_prime_reference(expected)) expected += 2;
+
+        ck_assert_uint_eq(primes[i].prime, expected);
+        ck_assert_uint_eq(primes[i].prime * primes[i].inverse, 1);
+        ck_assert_uint_eq(primes[i].limit, UINT64_MAX / primes[i].prime);
+    }
+    ck_assert_uint_eq(primes[SMALL_PRIMES_COUNT - 1].prime, SMALL_PRIMES_LARGEST);
+}
+END_TEST
+
+
+START_TEST(tables_wheel)
+{
+    const uint8_t *increments = get_wheel_increments();
+    size_t candidate = WHEEL_START;
+    size_t spoke = WHEEL_START_SPOKE;
+
+    /* two turns of the wheel visit every number coprime to its modulus, and nothing else */
+    for (size_t number = WHEEL_START; number < WHEEL_START + 2 * WHEEL_MODULUS; ++number)
+    {
+        bool coprime = number % 2 && number % 3 && number % 5 && number % 7;
+        if (!coprime) continue;
+
+        ck_assert_uint_eq(candidate, number);
+        candidate += increments[spoke];
+        spoke = (spoke + 1) % WHEEL_SPOKES;
+    }
+}
+END_TEST
+
+
+START_TEST(tables_trial_division)
+{
+    /* squares and products of primes around the end of the table and the wheel start */
+    for (size_t p = SMALL_PRIMES_LARGEST - 200; p < WHEEL_START + 200; ++p)
+    {
+        ck_assert_int_eq(is_prime(p), is_prime_reference(p));
+        ck_assert_int_eq(is_prime(p * p), false);
+        ck_assert_int_eq(is_prime(p * (p + 2)), is_prime_reference(p * (p + 2)));
+    }
+
+    for (size_t number = (1ul << 53) - 100; number < (1ul << 53) + 100; ++number)
+    {
+        ck_assert_int_eq(is_prime(number), is_prime_reference(number));
+    }
+}
+END_TEST
+
+
+static Suite *small_primes_suite(void)
+{
+    Suite *suite = suite_create("small_primes");
+    TCase *tcase = tcase_create("filter");
+
+    tcase_add_test(tcase, filter_small_numbers);
+    tcase_add_test(tcase, filter_large_numbers);
+    suite_add_tcase(suite, tcase);
+
+    tcase = tcase_create("tables");
+    tcase_add_test(tcase, tables_small_primes);
+    tcase_add_test(tcase, tables_wheel);
+    tcase_add_test(tcase, tables_trial_division);
+    suite_add_tcase(suite, tcase);
+
+    tcase = tcase_create("batch");
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, filter_batch_kernels);
+    tcase_add_test(tcase, batch_cached_lookups);
+    suite_add_tcase(suite, tcase);
+
+    return suite;
+}
+
+
+START_TEST(pmpr_table)
+{
+    /* second run is answered by the memoized roots */
+    for (size_t run = 0; run < 2; ++run)
+    {
+        dynarr_t *table = create_pair_array();
+        calc_PMPR_table(0, 1023, &table);
+
+        size_t i = 0;
+        for (size_t prime = 3; prime <= 1023; ++prime)
+        {
+            if (!is_prime_reference(prime)) continue;
+
+            ck_assert_uint_lt(i, dynarr_size(table));
+            const pair_t *pair = (const pair_t*) dynarr_get(table, i++);
+            ck_assert_uint_eq(pair->first, prime);
+            ck_assert_uint_eq(pair->second, medium_range_proot_reference(prime));
+        }
+        ck_assert_uint_eq(i, dynarr_size(table));
+
+        dynarr_destroy(table);
+    }
+}
+END_TEST
+
+
+START_TEST(pmpr_table_windows)
+{
+    /* a range spanning several factorization windows, checked against single root queries */
+    size_t begin = 100000;
+    size_t end = 170000;
+
+    dynarr_t *table = create_pair_array();
+    calc_PMPR_table(begin, end, &table);
+    ck_assert_uint_gt(dynarr_size(table), 0);
+
+    for (size_t i = 0; i < dynarr_size(table); i += 31)
+    {
+        const pair_t *pair = (const pair_t*) dynarr_get(table, i);
+        ck_assert(is_prime_reference(pair->first));
+        ck_assert_uint_eq(pair->second, calc_medium_range_proot(pair->first));
+    }
+
+    dynarr_destroy(table);
+}
+END_TEST
+
+
+START_TEST(proot_context_reuse)
+{
+    /* one context for primes of growing and shrinking size */
+    proot_ctx_t *ctx = proot_ctx_create(16);
+    static const size_t primes[] = { 3, 7, 41, 1021, 23, 65537, 103, 999983, 5 };
+
+    for (size_t i = 0; i < sizeof(primes) / sizeof(primes[0]); ++i)
+    {
+        size_t prime = primes[i];
+        size_t lowest = 2;
+        while (order_reference(lowest, prime) != prime - 1) ++lowest;
+
+        ck_assert_uint_eq(get_lowest_primitive_root_ctx(ctx, prime), lowest);
+        ck_assert_uint_eq(get_lowest_primitive_root(prime), lowest);
+        if (prime < 2000)
+        {
+            ck_assert_uint_eq(calc_medium_range_proot_ctx(ctx, prime), medium_range_proot_reference(prime));
+        }
+    }
+
+    /* 2 is reported as a prime without roots */
+    ck_assert_uint_eq(get_lowest_primitive_root_ctx(ctx, 2), 0);
+    proot_ctx_destroy(ctx);
+}
+END_TEST
+
+
+START_TEST(proot_lowest_roots)
+{
+    /* includes primes such as 23, 41 and 103 whose roots lie past a count based cutoff */
+    for (size_t prime = 3; prime < 3000; prime += 2)
+    {
+        if (!is_prime_reference(prime)) continue;
+
+        size_t lowest = 2;
+        while (order_reference(lowest, prime) != prime - 1) ++lowest;
+        ck_assert_uint_eq(get_lowest_primitive_root(prime), lowest);
+    }
+
+    /* above 2^32, where products of the old modpow overflowed */
+    ck_assert_uint_eq(get_lowest_primitive_root((1ul << 61) - 1), 37);
+}
+END_TEST
+
+
+START_TEST(proot_below_three)
+{
+    /* no primitive roots, and nothing to factor */
+    proot_ctx_t *ctx = proot_ctx_create(0);
+    for (size_t number = 0; number < 3; ++number)
+    {
+        ck_assert_uint_eq(get_lowest_primitive_root(number), 0);
+        ck_assert_uint_eq(get_lowest_primitive_root_ctx(ctx, number), 0);
+        ck_assert_uint_eq(calc_medium_range_proot(number), 0);
+    }
+    proot_ctx_destroy(ctx);
+
+    /* 1 and 2 are left out of the table as before */
+    dynarr_t *table = create_pair_array();
+    calc_PMPR_table(1, 30, &table);
+
+    size_t i = 0;
+    for (size_t prime = 3; prime <= 30; ++prime)
+    {
+        if (!is_prime_reference(prime)) continue;
+
+        ck_assert_uint_lt(i, dynarr_size(table));
+        const pair_t *pair = (const pair_t*) dynarr_get(table, i++);
+        ck_assert_uint_eq(pair->first, prime);
+        ck_assert_uint_eq(pair->second, medium_range_proot_reference(prime));
+    }
+    ck_assert_uint_eq(i, dynarr_size(table));
+
+    dynarr_destroy(table);
+}
+END_TEST
+
+
+START_TEST(proot_walk)
+{
+    proot_ctx_t *ctx = proot_ctx_create(0);
+    long visited[2048 + 1];
+
+    for (size_t prime = 3; prime < 2048; prime += 2)
+    {
+        if (!is_prime_reference(prime)) continue;
+        size_t lowest = get_lowest_primitive_root(prime);
+
+        /* every root exactly once, in any order */
+        memset(visited, 0, sizeof(visited));
+        walk_primitive_roots(ctx, prime, lowest, mark_visited_root, visited);
+
+        dynarr_t *roots = create_primes_array();
+        get_primitive_roots(prime, lowest, &roots);
+
+        size_t count = 0;
+        for (size_t number = 1; number < prime; ++number)
+        {
+            bool root = order_reference(number, prime) == prime - 1;
+            ck_assert_int_eq(visited[number], root);
+            if (!root) continue;
+
+            /* sorted list of the same roots */
+            ck_assert_uint_lt(count, dynarr_size(roots));
+            ck_assert_uint_eq(*(size_t*) dynarr_get(roots, count), number);
+            ++count;
+        }
+        ck_assert_uint_eq(visited[0], count);
+        ck_assert_uint_eq(dynarr_size(roots), count);
+        dynarr_destroy(roots);
+
+        /* walk stops once the callback returns false */
+        memset(visited, 0, sizeof(visited));
+        visited[0] = -1;
+        walk_primitive_roots(ctx, prime, lowest, mark_visited_root, visited);
+        ck_assert_int_eq(-visited[0] - 1, count < 10 ? count : 10);
+    }
+
+    proot_ctx_destroy(ctx);
+}
+END_TEST
+
+
+static Suite *pmpr_suite(void)
+{
+    Suite *suite = suite_create("pmpr");
+    TCase *tcase = tcase_create("table");
+
+    tcase_set_timeout(tcase, 120);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, pmpr_table);
+    tcase_add_test(tcase, proot_context_reuse);
+    tcase_add_test(tcase, proot_lowest_roots);
+    tcase_add_test(tcase, proot_below_three);
+    tcase_add_test(tcase, proot_walk);
+    tcase_add_test(tcase, pmpr_table_windows);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(store_grows_and_persists)
+{
+    hash_store_t store;
+    hash_store_open(&store, "check.store", sizeof(size_t));
+
+    /* several doublings of the initial capacity */
+    for (size_t key = 1; key <= 20000; ++key)
+    {
+        size_t value = key * key;
+        hash_store_insert(&store, key, &value);
+    }
+    size_t value = 7;
+    hash_store_insert(&store, 5, &value);
+    hash_store_close(&store);
+
+    hash_store_open(&store, "check.store", sizeof(size_t));
+    ck_assert_uint_eq(hash_store_size(&store), 20000);
+    ck_assert_ptr_null(hash_store_find(&store, 20001));
+    ck_assert_uint_eq(*(const size_t*) hash_store_find(&store, 5), 7);
+
+    for (size_t key = 6; key <= 20000; ++key)
+    {
+        const size_t *found = (const size_t*) hash_store_find(&store, key);
+        ck_assert_ptr_nonnull(found);
+        ck_assert_uint_eq(*found, key * key);
+    }
+    hash_store_close(&store);
+}
+END_TEST
+
+
+START_TEST(store_rejects_truncated)
+{
+    hash_store_t store;
+    hash_store_open(&store, "truncated.store", sizeof(size_t));
+    hash_store_close(&store);
+
+    /* header claims more slots than the file holds */
+    ck_assert_int_eq(truncate("truncated.store", 4096), 0);
+    hash_store_open(&store, "truncated.store", sizeof(size_t));
+}
+END_TEST
+
+
+START_TEST(store_rejects_foreign)
+{
+    int fd = open("foreign.store", O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    ck_assert_int_eq(write(fd, "not a store", 11), 11);
+    close(fd);
+
+    hash_store_t store;
+    hash_store_open(&store, "foreign.store", sizeof(size_t));
+}
+END_TEST
+
+
+static Suite *hash_store_suite(void)
+{
+    Suite *suite = suite_create("hash_store");
+    TCase *tcase = tcase_create("file");
+
+    tcase_add_test(tcase, store_grows_and_persists);
+    tcase_add_exit_test(tcase, store_rejects_truncated, EXIT_FAILURE);
+    tcase_add_exit_test(tcase, store_rejects_foreign, EXIT_FAILURE);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(range_small_numbers)
+{
+    size_t bounds[][2] = {{0, 0}, {0, 1}, {0, 2}, {1, 2}, {2, 2}, {2, 3}, {0, 100000}};
+
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); ++i)
+    {
+        dynarr_t *primes = create_primes_array();
+        get_primes_range(bounds[i][0], bounds[i][1], &primes);
+        check_primes_array(primes, bounds[i][0], bounds[i][1]);
+        dynarr_destroy(primes);
+    }
+}
+END_TEST
+
+
+START_TEST(range_l1_boundary)
+{
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(L1_CACHE_LIMIT - 100000, L1_CACHE_LIMIT + 100000, 3, &primes);
+    check_primes_array(primes, L1_CACHE_LIMIT - 100000, L1_CACHE_LIMIT + 100000);
+    dynarr_destroy(primes);
+}
+END_TEST
+
+
+START_TEST(range_file_boundary)
+{
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(FILE_BOUNDARY - 300000, FILE_BOUNDARY + 300000, 2, &primes);
+    check_primes_array(primes, FILE_BOUNDARY - 300000, FILE_BOUNDARY + 300000);
+    dynarr_destroy(primes);
+}
+END_TEST
+
+
+START_TEST(range_large_sieving_primes)
+{
+    /* square root above the small sieving primes, the rest is crossed out by buckets */
+    size_t begin = (1ul << 52) + (1ul << 28) - 100000;
+
+    dynarr_t *primes = create_primes_array();
+    get_primes_range(begin, begin + 400000, &primes);
+    check_primes_array(primes, begin, begin + 400000);
+    dynarr_destroy(primes);
+}
+END_TEST
+
+
+START_TEST(range_top_of_numbers)
+{
+    /* segments below 2^64 one by one, each window resumes buckets of the previous one */
+    for (size_t k = 3; k > 0; --k)
+    {
+        size_t begin = 0 - k * SEGMENT_NUMBERS;
+        size_t end = begin + SEGMENT_NUMBERS - 1;
+
+        stats_reset();
+        dynarr_t *primes = create_primes_array();
+        get_primes_range(begin, end, &primes);
+        check_primes_array(primes, begin, end);
+        dynarr_destroy(primes);
+
+        stats_t stats;
+        stats_get(&stats);
+        ck_assert_uint_eq(stats.counters[STATS_BUCKETS_RESUMED], k < 3);
+    }
+}
+END_TEST
+
+
+START_TEST(range_buckets_parallel)
+{
+    size_t begin = (1ul << 63) + 7;
+    size_t end = (1ul << 63) + 4 * SEGMENT_NUMBERS - 1;
+
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(begin, end, 2, &primes);
+    check_primes_array(primes, begin, end);
+    dynarr_destroy(primes);
+
+    /* the last run keeps its buckets for the range following it */
+    stats_reset();
+    primes = create_primes_array();
+    get_primes_range(end + 1, end + 100000, &primes);
+    check_primes_array(primes, end + 1, end + 100000);
+    dynarr_destroy(primes);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BUCKETS_RESUMED], 1);
+}
+END_TEST
+
+
+START_TEST(range_concurrent_callers)
+{
+    /* each caller needs more sieving primes than the previous one, they grow while others sieve */
+    size_t begins[RANGE_CALLERS] = {1ul << 30, 1ul << 38, FILE_BOUNDARY + 1000000, (1ul << 52) + 1000000};
+    range_call_t calls[RANGE_CALLERS];
+    pthread_t threads[RANGE_CALLERS];
+
+    for (size_t i = 0; i < RANGE_CALLERS; ++i)
+    {
+        calls[i] = (range_call_t){begins[i], begins[i] + 600000, create_primes_array()};
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, call_range_engine, &calls[i]), 0);
+    }
+
+    for (size_t i = 0; i < RANGE_CALLERS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        check_primes_array(calls[i].primes, calls[i].begin, calls[i].end);
+        dynarr_destroy(calls[i].primes);
+    }
+}
+END_TEST
+
+
+START_TEST(numa_partitions)
+{
+    set_numa_mode(true);
+
+    /* a single thread takes one node only, zero threads take every cpu of every node */
+    size_t threads[] = {1, 2, 0};
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i)
+    {
+        size_t begin = FILE_BOUNDARY - 500000 + i * 1000000;
+
+        dynarr_t *primes = create_primes_array();
+        get_primes_range_parallel(begin, begin + 700000, threads[i], &primes);
+        check_primes_array(primes, begin, begin + 700000);
+        dynarr_destroy(primes);
+    }
+
+    char report[256] = {};
+    FILE *file = fmemopen(report, sizeof(report) - 1, "w");
+    print_numa_report(file);
+    fclose(file);
+    ck_assert_ptr_nonnull(strstr(report, "segments"));
+
+    set_numa_mode(false);
+}
+END_TEST
+
+
+static Suite *range_suite(void)
+{
+    Suite *suite = suite_create("range");
+    TCase *tcase = tcase_create("engine");
+
+    tcase_set_timeout(tcase, 120);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, range_small_numbers);
+    tcase_add_test(tcase, range_l1_boundary);
+    tcase_add_test(tcase, range_file_boundary);
+    tcase_add_test(tcase, range_large_sieving_primes);
+    tcase_add_test(tcase, range_concurrent_callers);
+    suite_add_tcase(suite, tcase);
+
+    tcase = tcase_create("buckets");
+    tcase_set_timeout(tcase, 300);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, range_top_of_numbers);
+    tcase_add_test(tcase, range_buckets_parallel);
+    suite_add_tcase(suite, tcase);
+
+    tcase = tcase_create("numa");
+    tcase_set_timeout(tcase, 120);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, numa_partitions);
+    suite_add_tcase(suite, tcase);
+
+    return suite;
+}
+
+
+START_TEST(stats_counts_lookups)
+{
+    stats_reset();
+    for (size_t number = 0; number < 1000; ++number)
+    {
+        is_prime_cached(number);
+    }
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_LOOKUPS], 1000);
+    /* even numbers are answered before the bitset */
+    ck_assert_uint_eq(stats.counters[STATS_L1_HITS], 500);
+
+    stats_reset();
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_LOOKUPS], 0);
+}
+END_TEST
+
+
+START_TEST(stats_retired_threads)
+{
+    stats_reset();
+
+    pthread_t thread;
+    ck_assert_int_eq(pthread_create(&thread, NULL, add_thread_stats, NULL), 0);
+    pthread_join(thread, NULL);
+    stats_add(STATS_BLOCK_FILLS, 2);
+
+    /* counters of the finished thread are kept, until the next reset */
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 1000 + 2);
+
+    stats_reset();
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 0);
+}
+END_TEST
+
+
+START_TEST(stats_timing)
+{
+    stats_reset();
+    ck_assert_uint_eq(stats_clock(), 0);
+
+    stats_set_timing(true);
+    for (size_t number = L1_CACHE_LIMIT + 1; number < L1_CACHE_LIMIT + 2000; number += 2)
+    {
+        is_prime_cached(number);
+    }
+    ck_assert_uint_ne(stats_clock(), 0);
+    stats_set_timing(false);
+
+    stats_t stats;
+    stats_get(&stats);
+    size_t events = 0;
+    for (size_t b = 0; b < STATS_HISTOGRAM_BUCKETS; ++b)
+    {
+        events += stats.histograms[STATS_LOOKUP_LATENCY][b] + stats.histograms[STATS_MISS_LATENCY][b];
+    }
+    ck_assert_uint_gt(events, 0);
+    ck_assert_uint_eq(stats_clock(), 0);
+
+    char dump[4096] = {};
+    FILE *file = fmemopen(dump, sizeof(dump) - 1, "w");
+    stats_dump(file);
+    fclose(file);
+    ck_assert_ptr_nonnull(strstr(dump, "lookup_latency"));
+}
+END_TEST
+
+
+static Suite *stats_suite(void)
+{
+    Suite *suite = suite_create("stats");
+    TCase *tcase = tcase_create("counters");
+
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, stats_counts_lookups);
+    tcase_add_test(tcase, stats_retired_threads);
+    tcase_add_test(tcase, stats_timing);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(protocol_queries)
+{
+    pthread_t server;
+    ck_assert_int_eq(pthread_create(&server, NULL, run_server, NULL), 0);
+
+    client_t client;
+    connect_server(&client);
+
+    size_t numbers[] = {0, 1, 2, 3, 4, L1_CACHE_LIMIT - 1, L1_CACHE_LIMIT + 1,
+        FILE_BOUNDARY - 1, FILE_BOUNDARY + 1, (1ul << 52) + 1, (1ul << 52) + 3};
+    size_t count = sizeof(numbers) / sizeof(numbers[0]);
+    bool primes[sizeof(numbers) / sizeof(numbers[0])];
+
+    ck_assert_int_eq(client_are_primes(&client, numbers, count, primes), PROTO_OK);
+    for (size_t i = 0; i < count; ++i)
+    {
+        ck_assert_msg(primes[i] == is_prime_reference(numbers[i]), "daemon differs on %zu", numbers[i]);
+    }
+
+    dynarr_t *range = create_primes_array();
+    ck_assert_int_eq(client_get_primes_range(&client, L1_CACHE_LIMIT - 5000, L1_CACHE_LIMIT + 5000, &range), PROTO_OK);
+    check_primes_array(range, L1_CACHE_LIMIT - 5000, L1_CACHE_LIMIT + 5000);
+
+    /* several slices of the server, pi(10^8) = 5761455 */
+    dynarr_clear(range);
+    ck_assert_int_eq(client_get_primes_range(&client, 0, 100000000, &range), PROTO_OK);
+    ck_assert_uint_eq(dynarr_size(range), 5761455);
+    ck_assert_uint_eq(*(size_t*) dynarr_get(range, 0), 2);
+    ck_assert_uint_eq(*(size_t*) dynarr_get(range, 5761454), 99999989);
+    dynarr_destroy(range);
+
+    size_t amount;
+    ck_assert_int_eq(client_count_primes(&client, 0, 100000000, &amount), PROTO_OK);
+    ck_assert_uint_eq(amount, 5761455);
+    ck_assert_int_eq(client_count_primes(&client, 2, 2, &amount), PROTO_OK);
+    ck_assert_uint_eq(amount, 1);
+
+    /* slices of PMPR are shorter, the higher their numbers are */
+    dynarr_t *table = create_pair_array();
+    ck_assert_int_eq(client_calc_PMPR_table(&client, 100000, 200000, &table), PROTO_OK);
+
+    client_disconnect(&client);
+    server_stop();
+
+    /* wakes the server up, it is the only user of the cache again once joined */
+    connect_server(&client);
+    client_disconnect(&client);
+    pthread_join(server, NULL);
+
+    dynarr_t *expected = create_pair_array();
+    calc_PMPR_table(100000, 200000, &expected);
+    ck_assert_uint_eq(dynarr_size(table), dynarr_size(expected));
+    ck_assert_int_eq(memcmp(dynarr_get(table, 0), dynarr_get(expected, 0), dynarr_size(table) * sizeof(pair_t)), 0);
+
+    dynarr_destroy(table);
+    dynarr_destroy(expected);
+}
+END_TEST
+
+
+START_TEST(protocol_errors)
+{
+    pthread_t server;
+    ck_assert_int_eq(pthread_create(&server, NULL, run_server, NULL), 0);
+
+    client_t client;
+    connect_server(&client);
+
+    uint64_t reversed[2] = {100, 10};
+    proto_response_t response = exchange_raw(&client, PROTO_RANGE, reversed, 2);
+    ck_assert_uint_eq(response.status, PROTO_BAD_ARGS);
+    ck_assert_uint_eq(response.count, 0);
+
+    response = exchange_raw(&client, PROTO_COUNT, reversed, 1);
+    ck_assert_uint_eq(response.status, PROTO_BAD_ARGS);
+
+    uint64_t wide[2] = {0, PROTO_MAX_RANGE};
+    response = exchange_raw(&client, PROTO_RANGE, wide, 2);
+    ck_assert_uint_eq(response.status, PROTO_TOO_LARGE);
+
+    /* connection is still usable after rejected arguments */
+    uint64_t single[2] = {FILE_BOUNDARY - 1, FILE_BOUNDARY - 1};
+    response = exchange_raw(&client, PROTO_COUNT, single, 2);
+    ck_assert_uint_eq(response.status, PROTO_OK);
+    ck_assert_uint_eq(response.count, 1);
+
+    uint64_t amount;
+    ck_assert_int_eq(recv(client.fd, &amount, sizeof(amount), MSG_WAITALL), sizeof(amount));
+    ck_assert_uint_eq(amount, is_prime_reference(FILE_BOUNDARY - 1));
+
+    /* unknown operation is answered, then the connection is closed */
+    response = exchange_raw(&client, 99, NULL, 0);
+    ck_assert_uint_eq(response.status, PROTO_BAD_OP);
+    ck_assert_int_eq(recv(client.fd, &amount, sizeof(amount), 0), 0);
+    client_disconnect(&client);
+
+    server_stop();
+    connect_server(&client);
+    client_disconnect(&client);
+    pthread_join(server, NULL);
+}
+END_TEST
+
+
+static Suite *protocol_suite(void)
+{
+    Suite *suite = suite_create("protocol");
+    TCase *tcase = tcase_create("daemon");
+
+    tcase_set_timeout(tcase, 120);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, protocol_queries);
+    tcase_add_test(tcase, protocol_errors);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(reader_unpublished)
+{
+    cache_reader_t *reader = cache_reader_open();
+    bool prime;
+
+    /* even numbers need no cache */
+    ck_assert(cache_reader_check_prime(reader, 0, &prime) && !prime);
+    ck_assert(cache_reader_check_prime(reader, 2, &prime) && prime);
+    ck_assert(cache_reader_check_prime(reader, 4, &prime) && !prime);
+
+    /* neither the first segment nor the file of 2^48 is computed by the checks */
+    ck_assert(!cache_reader_check_prime(reader, 3, &prime));
+    ck_assert(!cache_reader_check_prime(reader, (1ul << 48) + 1, &prime));
+
+    dynarr_t *primes = create_primes_array();
+    ck_assert_uint_eq(cache_reader_get_primes_range(reader, 1ul << 48, (1ul << 48) + 1000, &primes), 1ul << 48);
+    ck_assert_uint_eq(dynarr_size(primes), 0);
+
+    dynarr_destroy(primes);
+    cache_reader_close(reader);
+}
+END_TEST
+
+
+START_TEST(reader_follows_growth)
+{
+    cache_reader_t *reader = cache_reader_open();
+    dynarr_t *primes = create_primes_array();
+
+    /* each range grows the cache file past the part already mapped by the reader */
+    size_t begins[] = {L1_CACHE_LIMIT, 1ul << 32, FILE_BOUNDARY - 200000, FILE_BOUNDARY + (1ul << 34)};
+    for (size_t i = 0; i < sizeof(begins) / sizeof(begins[0]); ++i)
+    {
+        size_t begin = begins[i];
+        size_t end = begin + 400000;
+
+        dynarr_t *computed = create_primes_array();
+        get_primes_range_parallel(begin, end, 2, &computed);
+        dynarr_destroy(computed);
+
+        dynarr_clear(primes);
+        ck_assert_uint_eq(cache_reader_get_primes_range(reader, begin, end, &primes), end + 1);
+        check_primes_array(primes, begin, end);
+
+        for (size_t number = begin + 1; number <= end; number += 1001)
+        {
+            bool prime;
+            ck_assert(cache_reader_check_prime(reader, number, &prime));
+            ck_assert_int_eq(prime, is_prime_reference(number));
+        }
+    }
+
+    dynarr_destroy(primes);
+    cache_reader_close(reader);
+}
+END_TEST
+
+
+static Suite *reader_suite(void)
+{
+    Suite *suite = suite_create("reader");
+    TCase *tcase = tcase_create("mapping");
+
+    tcase_set_timeout(tcase, 120);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, reader_unpublished);
+    tcase_add_test(tcase, reader_follows_growth);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(freeze_and_thaw)
+{
+    /* numbers below the bitset limit are never stored in the cache files */
+    ck_assert_uint_eq(freeze_cache_range(0, 2), 0);
+    ck_assert_uint_eq(freeze_cache_range(1ul << 40, (1ul << 40) + 1000000), 0);
+
+    size_t begin = (1ul << 40) + 1;
+    size_t end = (1ul << 40) + 3000000;
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(begin, end, 2, &primes);
+    size_t count = dynarr_size(primes);
+
+    reset_cache_stats();
+    size_t frozen = freeze_cache_range(begin, end);
+    ck_assert_uint_gt(frozen, 0);
+    ck_assert_uint_eq(freeze_cache_range(begin, end), 0);
+
+    /* withdrawn from readers, counted and collected again from the cold tier */
+    cache_reader_t *reader = cache_reader_open();
+    bool prime;
+    ck_assert(!cache_reader_check_prime(reader, begin + 1000000, &prime));
+    cache_reader_close(reader);
+
+    ck_assert_uint_eq(count_primes_range(begin, end), count);
+    dynarr_clear(primes);
+    get_primes_range(begin, end, &primes);
+    check_primes_array(primes, begin, end);
+
+    /* frozen again, then thawed by point lookups */
+    ck_assert_uint_eq(freeze_cache_range(begin, end), frozen);
+    check_cached_range(end - 3000, end);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_SEGMENTS_FROZEN], 2 * frozen);
+    ck_assert_uint_ge(stats.counters[STATS_SEGMENTS_THAWED], frozen + 1);
+
+    dynarr_destroy(primes);
+}
+END_TEST
+
+
+START_TEST(freeze_skips_open_views)
+{
+    size_t begin = (1ul << 41) + 1;
+    size_t end = (1ul << 41) + 2000000;
+
+    prime_view_t *view = prime_view_open(begin, end);
+    ck_assert_uint_eq(freeze_cache_range(begin, end), 0);
+    ck_assert_uint_eq(prime_view_count(view), count_primes_range(begin, end));
+    prime_view_close(view);
+
+    ck_assert_uint_gt(freeze_cache_range(begin, end), 0);
+}
+END_TEST
+
+
+static Suite *cold_store_suite(void)
+{
+    Suite *suite = suite_create("cold_store");
+    TCase *tcase = tcase_create("freeze");
+
+    tcase_set_timeout(tcase, 120);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, freeze_and_thaw);
+    tcase_add_test(tcase, freeze_skips_open_views);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(navigation_small_numbers)
+{
+    ck_assert_uint_eq(next_prime(0), 2);
+    ck_assert_uint_eq(next_prime(1), 2);
+    ck_assert_uint_eq(next_prime(2), 3);
+    ck_assert_uint_eq(prev_prime(0), 0);
+    ck_assert_uint_eq(prev_prime(2), 0);
+    ck_assert_uint_eq(prev_prime(3), 2);
+    ck_assert_uint_eq(next_prime(LARGEST_PRIME), 0);
+
+    ck_assert_uint_eq(next_prime_k(0, 4), 7);
+    ck_assert_uint_eq(prev_prime_k(12, 4), 3);
+    ck_assert_uint_eq(prev_prime_k(12, 6), 0);
+
+    check_navigation(0, 1000);
+}
+END_TEST
+
+
+START_TEST(navigation_boundaries)
+{
+    check_navigation(L1_CACHE_LIMIT - 500, L1_CACHE_LIMIT + 500);
+    check_navigation(FILE_BOUNDARY - 500, FILE_BOUNDARY + 500);
+
+    /* walks back over the whole gap to the last prime before the file */
+    size_t last = prev_prime(FILE_BOUNDARY);
+    ck_assert_uint_eq(prev_prime(next_prime(last)), last);
+}
+END_TEST
+
+
+START_TEST(navigation_large_numbers)
+{
+    /* sieving primes do not reach the square root, only windows of a few gaps are sieved */
+    check_navigation((1ul << 53) - 200, (1ul << 53) + 200);
+
+    size_t prime = next_prime_k(1ul << 53, 10);
+    ck_assert(is_prime_reference(prime));
+    ck_assert_uint_eq(prev_prime_k(prime, 10), prev_prime(next_prime(1ul << 53)));
+}
+END_TEST
+
+
+static Suite *navigation_suite(void)
+{
+    Suite *suite = suite_create("navigation");
+    TCase *tcase = tcase_create("next_prev");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, navigation_small_numbers);
+    tcase_add_test(tcase, navigation_boundaries);
+    tcase_add_test(tcase, navigation_large_numbers);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(miss_policy_number)
+{
+    set_miss_policy(MISS_POLICY_NUMBER);
+    stats_reset();
+    check_cached_range(1ul << 34, (1ul << 34) + 2000);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 0);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_HITS], 0);
+    size_t misses = stats.counters[STATS_CACHE_MISSES];
+    ck_assert_uint_gt(misses, 0);
+
+    /* second pass is answered by the stored cells */
+    check_cached_range(1ul << 34, (1ul << 34) + 2000);
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], misses);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_HITS], misses);
+}
+END_TEST
+
+
+START_TEST(miss_policy_page)
+{
+    set_miss_policy(MISS_POLICY_PAGE);
+    stats_reset();
+    check_cached_range(1ul << 35, (1ul << 35) + 2000);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 1);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], 1);
+
+    /* pages on both sides of a file boundary are filled on their own */
+    stats_reset();
+    check_cached_range(2 * FILE_BOUNDARY - 1000, 2 * FILE_BOUNDARY + 1000);
+    check_cached_batches(2 * FILE_BOUNDARY - 100, 200);
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 2);
+}
+END_TEST
+
+
+START_TEST(miss_policy_segment)
+{
+    set_miss_policy(MISS_POLICY_SEGMENT);
+    stats_reset();
+    check_cached_range(1ul << 36, (1ul << 36) + 2000);
+    check_cached_range((1ul << 36) + SEGMENT_NUMBERS - 2000, (1ul << 36) + SEGMENT_NUMBERS - 1);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 1);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], 1);
+}
+END_TEST
+
+
+START_TEST(miss_policy_large_numbers)
+{
+    /* sieving primes do not reach the square root, numbers are calculated one by one */
+    set_miss_policy(MISS_POLICY_PAGE);
+    stats_reset();
+    check_cached_range((1ul << 54) + 1, (1ul << 54) + 300);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_BLOCK_FILLS], 0);
+    ck_assert_uint_gt(stats.counters[STATS_CACHE_MISSES], 0);
+}
+END_TEST
+
+
+static Suite *miss_policy_suite(void)
+{
+    Suite *suite = suite_create("miss_policy");
+    TCase *tcase = tcase_create("policies");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, miss_policy_number);
+    tcase_add_test(tcase, miss_policy_page);
+    tcase_add_test(tcase, miss_policy_segment);
+    tcase_add_test(tcase, miss_policy_large_numbers);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(read_ahead_forward)
+{
+    /* stream crosses into the fourth cache file, read-ahead follows it */
+    size_t first = 3 * FILE_BOUNDARY / SEGMENT_NUMBERS - 6;
+
+    set_miss_policy(MISS_POLICY_NUMBER);
+    set_read_ahead(true);
+    stats_reset();
+
+    for (size_t segment = first; segment < first + 4; ++segment)
+    {
+        touch_segment(segment);
+    }
+    wait_read_ahead(4);
+
+    stats_t stats;
+    stats_get(&stats);
+    size_t misses = stats.counters[STATS_CACHE_MISSES];
+
+    check_cached_range(3 * FILE_BOUNDARY - 1000, 3 * FILE_BOUNDARY + 1000);
+    check_cached_range((first + 7) * SEGMENT_NUMBERS, (first + 7) * SEGMENT_NUMBERS + 1000);
+
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], misses);
+}
+END_TEST
+
+
+START_TEST(read_ahead_backward)
+{
+    size_t first = (1ul << 39) / SEGMENT_NUMBERS;
+
+    set_miss_policy(MISS_POLICY_NUMBER);
+    set_read_ahead(true);
+    stats_reset();
+
+    for (size_t segment = first; segment > first - 8; segment -= 2)
+    {
+        touch_segment(segment);
+    }
+    wait_read_ahead(4);
+
+    stats_t stats;
+    stats_get(&stats);
+    size_t misses = stats.counters[STATS_CACHE_MISSES];
+
+    check_cached_range((first - 8) * SEGMENT_NUMBERS, (first - 8) * SEGMENT_NUMBERS + 1000);
+    check_cached_range((first - 14) * SEGMENT_NUMBERS, (first - 14) * SEGMENT_NUMBERS + 1000);
+
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], misses);
+}
+END_TEST
+
+
+START_TEST(read_ahead_random)
+{
+    size_t segments[] = {1ul << 22, 5ul << 20, 3ul << 21, 1ul << 20};
+
+    set_miss_policy(MISS_POLICY_NUMBER);
+    set_read_ahead(true);
+    stats_reset();
+
+    for (size_t i = 0; i < sizeof(segments) / sizeof(segments[0]); ++i)
+    {
+        touch_segment(segments[i]);
+    }
+    set_read_ahead(false);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_SEGMENTS_READ_AHEAD], 0);
+}
+END_TEST
+
+
+static Suite *read_ahead_suite(void)
+{
+    Suite *suite = suite_create("read_ahead");
+    TCase *tcase = tcase_create("streams");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, read_ahead_forward);
+    tcase_add_test(tcase, read_ahead_backward);
+    tcase_add_test(tcase, read_ahead_random);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(budget_sheds_least_recent)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    int fd = open("check.budget", O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    ck_assert(-1 != fd);
+    ck_assert_int_eq(ftruncate(fd, 4 * BUDGET_PAGES * page_size), 0);
+
+    mem_budget_t budget;
+    mem_budget_init(&budget);
+    mem_budget_set_limit(&budget, BUDGET_PAGES * page_size);
+
+    for (size_t i = 0; i < 2 * BUDGET_PAGES; ++i)
+    {
+        char *region = mem_budget_acquire(&budget, 0, i * page_size, page_size, fd);
+        region[0] = (char) (i + 1);
+        ck_assert(mem_budget_release(&budget, region));
+    }
+
+    mem_usage_t usage;
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.mapped, BUDGET_PAGES * page_size);
+    ck_assert_uint_eq(usage.regions, BUDGET_PAGES);
+    ck_assert_uint_eq(usage.shed, BUDGET_PAGES * page_size);
+    ck_assert_uint_eq(usage.pinned, 0);
+    /* past 3/4 of the budget the least recent ones are cooled */
+    ck_assert_uint_ge(usage.cooled, page_size);
+
+    /* the most recent region is reused, the oldest one was shed and its data written back */
+    char *recent = mem_budget_acquire(&budget, 0, (2 * BUDGET_PAGES - 1) * page_size, page_size, fd);
+    char *oldest = mem_budget_acquire(&budget, 0, 0, page_size, fd);
+    ck_assert_int_eq(recent[0], 2 * BUDGET_PAGES);
+    ck_assert_int_eq(oldest[0], 1);
+
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.shed, (BUDGET_PAGES + 1) * page_size);
+    ck_assert_uint_eq(usage.pinned, 2 * page_size);
+
+    ck_assert(mem_budget_release(&budget, recent));
+    ck_assert(mem_budget_release(&budget, oldest));
+    ck_assert(!mem_budget_release(&budget, NULL));
+
+    mem_budget_close(&budget);
+    close(fd);
+}
+END_TEST
+
+
+START_TEST(budget_keeps_pinned)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    int fd = open("check.budget", O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    ck_assert(-1 != fd);
+    ck_assert_int_eq(ftruncate(fd, 4 * BUDGET_PAGES * page_size), 0);
+
+    mem_budget_t budget;
+    mem_budget_init(&budget);
+    mem_budget_set_limit(&budget, BUDGET_PAGES * page_size);
+
+    char *regions[2 * BUDGET_PAGES];
+    for (size_t i = 0; i < 2 * BUDGET_PAGES; ++i)
+    {
+        regions[i] = mem_budget_acquire(&budget, 0, i * page_size, page_size, fd);
+    }
+
+    mem_usage_t usage;
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.mapped, 2 * BUDGET_PAGES * page_size);
+    ck_assert_uint_eq(usage.shed, 0);
+
+    /* one pin of the own region aside, overlapping pinned regions count */
+    pthread_mutex_lock(&budget.lock);
+    ck_assert(!mem_budget_is_pinned(&budget, 0, 0, page_size, regions[0]));
+    ck_assert(mem_budget_is_pinned(&budget, 0, 0, 2 * page_size, regions[0]));
+    ck_assert(!mem_budget_is_pinned(&budget, 1, 0, page_size, NULL));
+    pthread_mutex_unlock(&budget.lock);
+
+    for (size_t i = 0; i < 2 * BUDGET_PAGES; ++i)
+    {
+        ck_assert(mem_budget_release(&budget, regions[i]));
+    }
+
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.mapped, BUDGET_PAGES * page_size);
+
+    /* without a budget unused regions are unmapped right away */
+    mem_budget_set_limit(&budget, 0);
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.regions, 0);
+
+    char *region = mem_budget_acquire(&budget, 0, 0, page_size, fd);
+    ck_assert(mem_budget_release(&budget, region));
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.regions, 0);
+
+    mem_budget_close(&budget);
+    close(fd);
+}
+END_TEST
+
+
+START_TEST(budget_many_regions)
+{
+    enum { PAGES = 1000 };
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    int fd = open("check.budget", O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    ck_assert(-1 != fd);
+    ck_assert_int_eq(ftruncate(fd, PAGES * page_size), 0);
+
+    mem_budget_t budget;
+    mem_budget_init(&budget);
+    mem_budget_set_limit(&budget, PAGES * page_size);
+
+    /* enough regions to grow the indexes several times */
+    static char *regions[PAGES];
+    for (size_t i = 0; i < PAGES; ++i)
+    {
+        regions[i] = mem_budget_acquire(&budget, i % 2, i / 2 * page_size, page_size, fd);
+        ck_assert(NULL != regions[i]);
+    }
+
+    /* released out of order, so regions move within the pool */
+    for (size_t i = 0; i < PAGES; ++i)
+    {
+        ck_assert(mem_budget_release(&budget, regions[i * 7 % PAGES]));
+    }
+    ck_assert(!mem_budget_release(&budget, (char*) &budget));
+
+    /* kept regions are found again by their file range */
+    for (size_t i = PAGES; i-- > 0; )
+    {
+        ck_assert_ptr_eq(mem_budget_acquire(&budget, i % 2, i / 2 * page_size, page_size, fd), regions[i]);
+    }
+    for (size_t i = 0; i < PAGES; ++i)
+    {
+        ck_assert(mem_budget_release(&budget, regions[i * 13 % PAGES]));
+    }
+
+    mem_usage_t usage;
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.regions, PAGES);
+    ck_assert_uint_eq(usage.shed, 0);
+
+    /* unmapped regions leave the indexes too */
+    mem_budget_set_limit(&budget, PAGES / 2 * page_size);
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.regions, PAGES / 2);
+
+    for (size_t i = 0; i < PAGES; ++i)
+    {
+        char *region = mem_budget_acquire(&budget, i % 2, i / 2 * page_size, page_size, fd);
+        ck_assert(mem_budget_release(&budget, region));
+    }
+
+    mem_budget_usage(&budget, &usage);
+    ck_assert_uint_eq(usage.regions, PAGES / 2);
+
+    mem_budget_close(&budget);
+    close(fd);
+}
+END_TEST
+
+
+START_TEST(budget_range_engine)
+{
+    size_t limit = 2 * SEGMENT_NUMBERS / 8;
+    size_t begin = 5ul << 40;
+    size_t end = begin + 8 * SEGMENT_NUMBERS;
+
+    set_cache_memory_budget(limit);
+
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(begin, end, 2, &primes);
+    check_primes_array(primes, begin, end);
+    dynarr_destroy(primes);
+
+    mem_usage_t usage;
+    get_cache_memory_usage(&usage);
+    ck_assert_uint_eq(usage.limit, limit);
+    ck_assert_uint_le(usage.mapped, limit);
+    ck_assert_uint_le(usage.resident, usage.mapped);
+    ck_assert_uint_gt(usage.shed, 0);
+}
+END_TEST
+
+
+static Suite *mem_budget_suite(void)
+{
+    Suite *suite = suite_create("mem_budget");
+    TCase *tcase = tcase_create("pool");
+
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, budget_sheds_least_recent);
+    tcase_add_test(tcase, budget_keeps_pinned);
+    tcase_add_test(tcase, budget_many_regions);
+    tcase_add_test(tcase, budget_range_engine);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(extents_dense_range)
+{
+    size_t begin = 6 * FILE_BOUNDARY - 2 * SEGMENT_NUMBERS;
+    size_t end = 6 * FILE_BOUNDARY + 2 * SEGMENT_NUMBERS - 1;
+
+    stats_reset();
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(begin, end, 2, &primes);
+    check_primes_array(primes, begin, end);
+    dynarr_destroy(primes);
+
+    struct stat first;
+    struct stat second;
+    ck_assert_int_eq(stat("primes.dat.5", &first), 0);
+    ck_assert_int_eq(stat("primes.dat.6", &second), 0);
+    ck_assert_uint_eq(first.st_size, MAX_FILE_SIZE);
+    ck_assert_uint_eq(second.st_size, 2 * SEGMENT_NUMBERS / 8);
+
+    /* one extent on each side of the file boundary, unless the file system lacks fallocate */
+    stats_t stats;
+    stats_get(&stats);
+    if (stats.counters[STATS_FILE_PREALLOCATIONS])
+    {
+        ck_assert_uint_eq(stats.counters[STATS_FILE_PREALLOCATIONS], 2);
+        ck_assert_uint_ge(first.st_blocks * 512, 2 * SEGMENT_NUMBERS / 8);
+        ck_assert_uint_ge(second.st_blocks * 512, 2 * SEGMENT_NUMBERS / 8);
+    }
+}
+END_TEST
+
+
+START_TEST(extents_sparse_lookups)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t number = 7 * FILE_BOUNDARY + (1ul << 40) + 1;
+    while (!is_prime_reference(number)) number += 2;
+
+    set_miss_policy(MISS_POLICY_NUMBER);
+    stats_reset();
+    ck_assert(is_prime_cached(number));
+
+    struct stat st;
+    ck_assert_int_eq(stat("primes.dat.7", &st), 0);
+    ck_assert_uint_eq(st.st_size, ((1ul << 40) / 8 / page_size + 1) * page_size);
+    ck_assert_uint_le(st.st_blocks * 512, 4 * page_size);
+
+    /* sizes are kept in memory, only growth reaches the file */
+    check_cached_range(number, number + 100);
+    check_cached_range(7 * FILE_BOUNDARY + 1, 7 * FILE_BOUNDARY + 100);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_FILE_EXTENSIONS], 1);
+    ck_assert_uint_eq(stats.counters[STATS_FILE_PREALLOCATIONS], 0);
+}
+END_TEST
+
+
+static Suite *extents_suite(void)
+{
+    Suite *suite = suite_create("extents");
+    TCase *tcase = tcase_create("files");
+
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, extents_dense_range);
+    tcase_add_test(tcase, extents_sparse_lookups);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(sparse_isolated_lookups)
+{
+    /* one prime in each of several files, none of them is created */
+    size_t primes[SPARSE_QUERIES];
+    for (size_t i = 0; i < SPARSE_QUERIES; ++i)
+    {
+        primes[i] = reference_prime_from((8 + i) * FILE_BOUNDARY + (i << 36));
+    }
+
+    set_sparse_mode(true);
+    stats_reset();
+    for (size_t i = 0; i < SPARSE_QUERIES; ++i)
+    {
+        ck_assert(is_prime_cached(primes[i]));
+    }
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_SPARSE_RESULTS], SPARSE_QUERIES);
+    ck_assert_uint_eq(stats.counters[STATS_SPARSE_PROMOTIONS], 0);
+    ck_assert_uint_eq(stats.counters[STATS_FILE_EXTENSIONS], 0);
+
+    struct stat st;
+    ck_assert_int_eq(stat("primes.dat.8", &st), -1);
+
+    /* results persist in the store */
+    fini_cache();
+    init_cache();
+    set_sparse_mode(true);
+    stats_reset();
+    for (size_t i = 0; i < SPARSE_QUERIES; ++i)
+    {
+        ck_assert(is_prime_cached(primes[i]));
+    }
+
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_HITS], SPARSE_QUERIES);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], 0);
+}
+END_TEST
+
+
+START_TEST(sparse_promotes_dense_pages)
+{
+    /* well over the results promoting a page */
+    size_t first = 24 * FILE_BOUNDARY + (1ul << 40);
+    size_t last = first + 2000;
+
+    set_sparse_mode(true);
+    set_miss_policy(MISS_POLICY_NUMBER);
+    stats_reset();
+    check_cached_range(first, last);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_SPARSE_PROMOTIONS], 1);
+    ck_assert_uint_gt(stats.counters[STATS_SPARSE_RESULTS], 0);
+    ck_assert_uint_eq(stats.counters[STATS_FILE_EXTENSIONS], 1);
+
+    /* promoted page is not stored sparsely any more */
+    stats_reset();
+    check_cached_range(first, last);
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_SPARSE_RESULTS], 0);
+    ck_assert_uint_eq(stats.counters[STATS_FILE_EXTENSIONS], 0);
+}
+END_TEST
+
+
+START_TEST(sparse_uses_published_segments)
+{
+    size_t begin = 10ul << 40;
+    size_t end = begin + SEGMENT_NUMBERS - 1;
+
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(begin, end, 2, &primes);
+    dynarr_destroy(primes);
+
+    set_sparse_mode(true);
+    stats_reset();
+    check_cached_range(end - 1000, end);
+
+    stats_t stats;
+    stats_get(&stats);
+    ck_assert_uint_eq(stats.counters[STATS_SPARSE_RESULTS], 0);
+    ck_assert_uint_eq(stats.counters[STATS_CACHE_MISSES], 0);
+}
+END_TEST
+
+
+static Suite *sparse_suite(void)
+{
+    Suite *suite = suite_create("sparse");
+    TCase *tcase = tcase_create("store");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, sparse_isolated_lookups);
+    tcase_add_test(tcase, sparse_promotes_dense_pages);
+    tcase_add_test(tcase, sparse_uses_published_segments);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(count_small_numbers)
+{
+    size_t bounds[][3] = {{0, 0, 0}, {0, 1, 0}, {0, 2, 1}, {2, 2, 1}, {3, 3, 1}, {0, 10, 4}, {0, 100000, 9592}};
+
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); ++i)
+    {
+        ck_assert_uint_eq(count_primes_range(bounds[i][0], bounds[i][1]), bounds[i][2]);
+    }
+    ck_assert_uint_eq(count_primes_range(L1_CACHE_LIMIT - 50000, L1_CACHE_LIMIT + 50000),
+        count_reference(L1_CACHE_LIMIT - 50000, L1_CACHE_LIMIT + 50000));
+}
+END_TEST
+
+
+START_TEST(count_recorded_pages)
+{
+    size_t begin = 11 * FILE_BOUNDARY - 2 * SEGMENT_NUMBERS;
+    size_t end = 11 * FILE_BOUNDARY + 2 * SEGMENT_NUMBERS - 1;
+
+    dynarr_t *primes = create_primes_array();
+    get_primes_range_parallel(begin, end, 2, &primes);
+    size_t count = dynarr_size(primes);
+    dynarr_destroy(primes);
+
+    /* pages are counted from the directory, unaligned ends from their cells */
+    ck_assert_uint_eq(count_primes_range(begin, end), count);
+    ck_assert_uint_eq(count_primes_range(11 * FILE_BOUNDARY - 100001, 11 * FILE_BOUNDARY + 99999),
+        count_reference(11 * FILE_BOUNDARY - 100001, 11 * FILE_BOUNDARY + 99999));
+
+    /* directory persists */
+    fini_cache();
+    init_cache();
+    ck_assert_uint_eq(count_primes_range(begin, end), count);
+}
+END_TEST
+
+
+START_TEST(count_large_numbers)
+{
+    size_t begin = (1ul << 53) + 12345;
+    ck_assert_uint_eq(count_primes_range(begin, begin + 100000), count_reference(begin, begin + 100000));
+}
+END_TEST
+
+
+START_TEST(count_point_lookups_skip_directory)
+{
+    set_miss_policy(MISS_POLICY_NUMBER);
+    ck_assert(is_prime_cached(reference_prime_from(12 * FILE_BOUNDARY + (1ul << 30))));
+
+    /* sidecars are opened by fills only */
+    struct stat st;
+    ck_assert_int_eq(stat("primes.dat.12", &st), 0);
+    ck_assert_int_eq(stat("primes.dat.12.pages", &st), -1);
+    ck_assert_int_eq(stat("primes.dat.12.state", &st), -1);
+}
+END_TEST
+
+
+static Suite *count_suite(void)
+{
+    Suite *suite = suite_create("count");
+    TCase *tcase = tcase_create("directory");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, count_small_numbers);
+    tcase_add_test(tcase, count_recorded_pages);
+    tcase_add_test(tcase, count_large_numbers);
+    tcase_add_test(tcase, count_point_lookups_skip_directory);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+START_TEST(view_small_numbers)
+{
+    size_t bounds[][2] = {{0, 0}, {0, 1}, {0, 2}, {2, 2}, {1, 3}, {2, 3}, {3, 100}, {0, 100000}};
+
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); ++i)
+    {
+        check_view(bounds[i][0], bounds[i][1]);
+    }
+    check_view(L1_CACHE_LIMIT - 50000, L1_CACHE_LIMIT + 50000);
+}
+END_TEST
+
+
+START_TEST(view_file_boundary)
+{
+    /* ranks of pages continue across the spans of both files */
+    check_view(26 * FILE_BOUNDARY - 100001, 26 * FILE_BOUNDARY + 99999);
+}
+END_TEST
+
+
+START_TEST(view_large_numbers)
+{
+    check_view(3 * (1ul << 52) + 1, 3 * (1ul << 52) + 100000);
+}
+END_TEST
+
+
+static Suite *view_suite(void)
+{
+    Suite *suite = suite_create("view");
+    TCase *tcase = tcase_create("rank_select");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, view_small_numbers);
+    tcase_add_test(tcase, view_file_boundary);
+    tcase_add_test(tcase, view_large_numbers);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+static const size_t s_twins[] = {0, 2};
+static const size_t s_quadruplets[] = {0, 2, 6, 8};
+
+
+START_TEST(patterns_small_numbers)
+{
+    size_t bounds[][2] = {{0, 0}, {0, 1}, {0, 2}, {2, 2}, {1, 3}, {2, 3}, {2, 5}, {3, 5}, {0, 100000}};
+    size_t singleton[] = {0};
+
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); ++i)
+    {
+        check_tuples(bounds[i][0], bounds[i][1], singleton, 1, -1ul);
+        check_tuples(bounds[i][0], bounds[i][1], s_twins, 2, -1ul);
+        check_tuples(bounds[i][0], bounds[i][1], s_quadruplets, 4, -1ul);
+        check_gaps(bounds[i][0], bounds[i][1], 1, -1ul);
+        check_gaps(bounds[i][0], bounds[i][1], 2, -1ul);
+        check_gaps(bounds[i][0], bounds[i][1], 36, -1ul);
+        check_gaps(bounds[i][0], bounds[i][1], 64, -1ul);
+    }
+
+    /* offsets have to be ascending even numbers starting from zero */
+    size_t invalid[][3] = {{2, 4, 6}, {0, 3, 6}, {0, 6, 2}, {0, 2, 2}};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+    {
+        ck_assert_uint_eq(find_prime_tuples(0, 1000, invalid[i], 3, collect_match, NULL), 0);
+    }
+    ck_assert_uint_eq(find_prime_tuples(0, 1000, invalid[0], 0, collect_match, NULL), 0);
+    ck_assert_uint_eq(find_prime_tuples(100, 99, s_twins, 2, collect_match, NULL), 0);
+    ck_assert_uint_eq(find_prime_gaps(100, 99, 2, collect_match, NULL), 0);
+}
+END_TEST
+
+
+START_TEST(patterns_file_boundary)
+{
+    size_t begin = 27 * FILE_BOUNDARY - 100001;
+    size_t end = 27 * FILE_BOUNDARY + 99999;
+
+    check_tuples(begin, end, s_twins, 2, -1ul);
+    check_tuples(begin, end, s_quadruplets, 4, -1ul);
+    check_gaps(begin, end, 20, -1ul);
+    check_gaps(begin, end, 100, -1ul);
+}
+END_TEST
+
+
+START_TEST(patterns_early_stop)
+{
+    check_tuples(0, 1000000, s_twins, 2, 3);
+    check_tuples(0, 1000000, s_quadruplets, 4, 1);
+    check_gaps(0, 1000000, 50, 5);
+    check_gaps(0, 1000000, 80, 2);
+
+    /* 2 matches by itself before the masks are searched */
+    size_t singleton[] = {0};
+    check_tuples(0, 1000000, singleton, 1, 1);
+}
+END_TEST
+
+
+START_TEST(patterns_large_numbers)
+{
+    size_t begin = 5 * (1ul << 52) + 1;
+    size_t end = begin + 200000;
+
+    check_tuples(begin, end, s_twins, 2, -1ul);
+    check_tuples(begin, end, s_quadruplets, 4, -1ul);
+    check_gaps(begin, end, 64, -1ul);
+    check_gaps(begin, end, 100, 4);
+}
+END_TEST
+
+
+static Suite *patterns_suite(void)
+{
+    Suite *suite = suite_create("patterns");
+    TCase *tcase = tcase_create("tuples_gaps");
+
+    tcase_set_timeout(tcase, 60);
+    tcase_add_checked_fixture(tcase, setup_cache, teardown_cache);
+    tcase_add_test(tcase, patterns_small_numbers);
+    tcase_add_test(tcase, patterns_file_boundary);
+    tcase_add_test(tcase, patterns_early_stop);
+    tcase_add_test(tcase, patterns_large_numbers);
+
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
+
+
+static size_t mul_mod(size_t a, size_t b, size_t modulus)
+{
+    return (unsigned __int128) a * b % modulus;
+}
+
+
+static size_t pow_mod(size_t base, size_t exponent, size_t modulus)
+{
+    size_t result = 1;
+    base %= modulus;
+
+    for (; exponent; exponent >>= 1)
+    {
+        if (exponent & 1) result = mul_mod(result, base, modulus);
+        base = mul_mod(base, base, modulus);
+    }
+    return result;
+}
+
+
+static bool is_prime_reference(size_t number)
+{
+    /* witnesses sufficient for every number below 2^64 */
+    static const size_t witnesses[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    static const size_t witnesses_count = sizeof(witnesses) / sizeof(witnesses[0]);
+
+    if (number < 2) return false;
+    for (size_t i = 0; i < witnesses_count; ++i)
+    {
+        if (number % witnesses[i] == 0) return number == witnesses[i];
+    }
+
+    size_t odd = number - 1;
+    size_t twos = 0;
+    for (; odd % 2 == 0; odd /= 2) ++twos;
+
+    for (size_t i = 0; i < witnesses_count; ++i)
+    {
+        size_t x = pow_mod(witnesses[i], odd, number);
+        if (x == 1 || x == number - 1) continue;
+
+        size_t r = 1;
+        for (; r < twos; ++r)
+        {
+            x = mul_mod(x, x, number);
+            if (x == number - 1) break;
+        }
+        if (r == twos) return false;
+    }
+    return true;
+}
+
+
+static void check_cached_range(size_t begin, size_t end)
+{
+    for (size_t number = begin; number <= end; ++number)
+    {
+        ck_assert_msg(is_prime_cached(number) == is_prime_reference(number),
+            "is_prime_cached(%zu) differs from the reference", number);
+    }
+}
+
+
+static void check_filtered(size_t number, cache_value_t value)
+{
+    if (UNDEFINED == value)
+    {
+        ck_assert_msg(number > SMALL_PRIMES_LARGEST * SMALL_PRIMES_LARGEST,
+            "small_primes_filter(%zu) left it undefined", number);
+        return;
+    }
+
+    ck_assert_msg((PRIME == value) == is_prime_reference(number),
+        "small_primes_filter(%zu) differs from the reference", number);
+}
+
+
+static void check_cached_batches(size_t first, size_t count)
+{
+    size_t *numbers = (size_t*) malloc(count * sizeof(size_t));
+    bool *out = (bool*) malloc(count * sizeof(bool));
+    ck_assert(numbers && out);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        numbers[i] = first + i;
+    }
+
+    for (size_t size = 1; size <= count; size += size / 4 + 1)
+    {
+        are_primes_cached(numbers, size, out);
+        for (size_t i = 0; i < size; ++i)
+        {
+            ck_assert_msg(out[i] == is_prime_reference(numbers[i]),
+                "are_primes_cached differs on %zu", numbers[i]);
+        }
+    }
+
+    free(numbers);
+    free(out);
+}
+
+
+static size_t medium_range_proot_reference(size_t prime)
+{
+    size_t roots = 0;
+    size_t middle = 0;
+
+    /* roots are counted first, the middle one is found by the second pass */
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        size_t rank = 0;
+        for (size_t candidate = 2; candidate < prime; ++candidate)
+        {
+            if (order_reference(candidate, prime) != prime - 1) continue;
+            if (pass && rank == roots / 2) middle = candidate;
+            ++rank;
+        }
+        roots = rank;
+    }
+
+    return middle;
+}
+
+
+static size_t order_reference(size_t number, size_t prime)
+{
+    size_t order = 1;
+    for (size_t power = number % prime; power != 1; ++order) power = power * number % prime;
+
+    return order;
+}
+
+
+static bool mark_visited_root(size_t root, void *param)
+{
+    long *visited = (long*) param;
+
+    if (visited[0] < 0)
+    {
+        --visited[0];
+        return visited[0] > -11;
+    }
+
+    ++visited[0];
+    ++visited[root];
+    return true;
+}
+
+
+static void check_primes_array(const dynarr_t *primes, size_t begin, size_t end)
+{
+    size_t found = 0;
+
+    /* `end` may be the largest number */
+    for (size_t number = begin; ; ++number)
+    {
+        if (is_prime_reference(number))
+        {
+            ck_assert_msg(found < dynarr_size(primes), "prime %zu is missing", number);
+            ck_assert_uint_eq(*(size_t*) dynarr_get(primes, found), number);
+            ++found;
+        }
+
+        if (number == end) break;
+    }
+
+    ck_assert_uint_eq(dynarr_size(primes), found);
+}
+
+
+static void check_navigation(size_t begin, size_t end)
+{
+    size_t next = begin;
+    while (!is_prime_reference(++next));
+
+    size_t prev = 0;
+    for (size_t number = begin - 1; number + 1 > 2; --number)
+    {
+        if (is_prime_reference(number))
+        {
+            prev = number;
+            break;
+        }
+    }
+
+    for (size_t number = begin; number < end; ++number)
+    {
+        if (number == next) while (!is_prime_reference(++next));
+        ck_assert_uint_eq(next_prime(number), next);
+        ck_assert_uint_eq(prev_prime(number), prev);
+        if (is_prime_reference(number)) prev = number;
+    }
+}
+
+
+static void *call_range_engine(void *param)
+{
+    range_call_t *call = (range_call_t*) param;
+    get_primes_range_parallel(call->begin, call->end, 2, &call->primes);
+
+    return NULL;
+}
+
+
+static void touch_segment(size_t segment)
+{
+    /* numbers answered by the filter never reach the cache file */
+    ck_assert(is_prime_cached(reference_prime_from(segment * SEGMENT_NUMBERS)));
+}
+
+
+static void wait_read_ahead(size_t count)
+{
+    stats_t stats;
+
+    for (size_t attempt = 0; attempt < 10000; ++attempt)
+    {
+        stats_get(&stats);
+        if (stats.counters[STATS_SEGMENTS_READ_AHEAD] >= count) break;
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+
+    ck_assert_uint_eq(stats.counters[STATS_SEGMENTS_READ_AHEAD], count);
+}
+
+
+static size_t reference_prime_from(size_t number)
+{
+    number |= 1;
+    while (!is_prime_reference(number)) number += 2;
+    return number;
+}
+
+
+static size_t count_reference(size_t begin, size_t end)
+{
+    size_t count = 0;
+    for (size_t number = begin; number <= end; ++number)
+    {
+        if (is_prime_reference(number)) ++count;
+    }
+    return count;
+}
+
+
+static void check_view(size_t begin, size_t end)
+{
+    prime_view_t *view = prime_view_open(begin, end);
+
+    size_t rank = 0;
+    for (size_t number = begin; number <= end; ++number)
+    {
+        if (is_prime_reference(number))
+        {
+            ck_assert_uint_eq(prime_view_select(view, rank), number);
+            ++rank;
+        }
+        ck_assert_uint_eq(prime_view_rank(view, number), rank);
+    }
+
+    ck_assert_uint_eq(prime_view_count(view), rank);
+    ck_assert_uint_eq(prime_view_select(view, rank), 0);
+    ck_assert_uint_eq(prime_view_rank(view, end + 1), rank);
+    if (begin) ck_assert_uint_eq(prime_view_rank(view, begin - 1), 0);
+
+    prime_view_close(view);
+}
+
+
+static bool collect_match(size_t prime, size_t width, void *param)
+{
+    match_list_t *list = (match_list_t*) param;
+    dynarr_append(&list->primes, &prime);
+    dynarr_append(&list->widths, &width);
+
+    return dynarr_size(list->primes) < list->limit;
+}
+
+
+static void check_tuples(size_t begin, size_t end, const size_t *offsets, size_t count, size_t limit)
+{
+    match_list_t list = {limit, create_primes_array(), create_primes_array()};
+    size_t matches = find_prime_tuples(begin, end, offsets, count, collect_match, &list);
+    ck_assert_uint_eq(matches, dynarr_size(list.primes));
+
+    size_t width = offsets[count - 1];
+    size_t found = 0;
+
+    for (size_t number = begin; number <= end && end - number >= width && found < limit; ++number)
+    {
+        size_t i = 0;
+        while (i < count && is_prime_reference(number + offsets[i])) ++i;
+        if (i < count) continue;
+
+        ck_assert_msg(found < matches, "tuple of %zu is missing", number);
+        ck_assert_uint_eq(*(size_t*) dynarr_get(list.primes, found), number);
+        ck_assert_uint_eq(*(size_t*) dynarr_get(list.widths, found), width);
+        ++found;
+    }
+
+    ck_assert_uint_eq(matches, found);
+    dynarr_destroy(list.primes);
+    dynarr_destroy(list.widths);
+}
+
+
+static void check_gaps(size_t begin, size_t end, size_t min_gap, size_t limit)
+{
+    match_list_t list = {limit, create_primes_array(), create_primes_array()};
+    size_t matches = find_prime_gaps(begin, end, min_gap, collect_match, &list);
+    ck_assert_uint_eq(matches, dynarr_size(list.primes));
+
+    size_t last = 0;
+    size_t found = 0;
+
+    for (size_t number = begin; number <= end && found < limit; ++number)
+    {
+        if (!is_prime_reference(number)) continue;
+
+        if (last && number - last >= min_gap)
+        {
+            ck_assert_msg(found < matches, "gap after %zu is missing", last);
+            ck_assert_uint_eq(*(size_t*) dynarr_get(list.primes, found), last);
+            ck_assert_uint_eq(*(size_t*) dynarr_get(list.widths, found), number - last);
+            ++found;
+        }
+        last = number;
+    }
+
+    ck_assert_uint_eq(matches, found);
+    dynarr_destroy(list.primes);
+    dynarr_destroy(list.widths);
+}
+
+
+static void *add_thread_stats(void *param)
+{
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        stats_add(STATS_BLOCK_FILLS, 1);
+    }
+
+    return NULL;
+}
+
+
+static void *run_server(void *param)
+{
+    server_run(CHECK_SOCKET);
+    return NULL;
+}
+
+
+static void connect_server(client_t *client)
+{
+    for (size_t attempt = 0; attempt < 1000; ++attempt)
+    {
+        if (client_connect(client, CHECK_SOCKET)) return;
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+
+    ck_abort_msg("server does not listen on " CHECK_SOCKET);
+}
+
+
+static proto_response_t exchange_raw(client_t *client, proto_op_t op, const uint64_t *payload, size_t count)
+{
+    proto_request_t request = { .op = op, .tag = client->next_tag++, .count = count };
+    ck_assert_int_eq(send(client->fd, &request, sizeof(request), MSG_NOSIGNAL), sizeof(request));
+    if (count)
+    {
+        ck_assert_int_eq(send(client->fd, payload, count * sizeof(uint64_t), MSG_NOSIGNAL), count * sizeof(uint64_t));
+    }
+
+    proto_response_t response;
+    ck_assert_int_eq(recv(client->fd, &response, sizeof(response), MSG_WAITALL), sizeof(response));
+    ck_assert_uint_eq(response.tag, request.tag);
+
+    return response;
+}
+
+
+static void setup_cache(void)
+{
+    init_cache();
+}
+
+
+static void teardown_cache(void)
+{
+    fini_cache();
+}
+
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
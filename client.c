@@ -0,0 +1,235 @@
+#include "client.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+* Amount of primes read from the socket at once.
+*/
+#define RECEIVE_CHUNK 4096
+
+/*
+* Batches sent ahead of the first unanswered one, keeps daemon busy
+* without letting its pending output reach MAX_PENDING_OUTPUT.
+*/
+#define PIPELINE_DEPTH 16
+
+static void send_request(client_t *client, proto_op_t op, const uint64_t *payload, size_t count);
+static void receive_response(client_t *client, proto_op_t op, proto_response_t *out);
+
+/*
+* Exchange of range operations: begin and end in, header of the response out,
+* payload is left in the socket.
+*/
+static proto_status_t range_request(client_t *client, proto_op_t op, size_t begin, size_t end,
+    proto_response_t *out);
+
+static void send_all(int fd, const void *data, size_t size);
+static void receive_all(int fd, void *data, size_t size);
+
+
+bool client_connect(client_t *client, const char *socket_path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, socket_path);
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    if (-1 == client->fd) exit(EXIT_FAILURE);
+
+    if (-1 == connect(client->fd, (struct sockaddr*) &addr, sizeof(addr)))
+    {
+        close(client->fd);
+        client->fd = -1;
+        return false;
+    }
+
+    client->next_tag = 0;
+    return true;
+}
+
+
+void client_disconnect(client_t *client)
+{
+    if (-1 != client->fd) close(client->fd);
+    client->fd = -1;
+}
+
+
+proto_status_t client_are_primes(client_t *client, const size_t *numbers, size_t count, bool *out)
+{
+    size_t batches = (count + PROTO_MAX_BATCH - 1) / PROTO_MAX_BATCH;
+    size_t sent = 0;
+    proto_status_t status = PROTO_OK;
+
+    for (size_t received = 0; received < batches; ++received)
+    {
+        /* pipelined, daemon works on next batches while previous answers are in flight */
+        for (; sent < batches && sent < received + PIPELINE_DEPTH; ++sent)
+        {
+            size_t first = sent * PROTO_MAX_BATCH;
+            size_t batch = count - first < PROTO_MAX_BATCH ? count - first : PROTO_MAX_BATCH;
+            send_request(client, PROTO_IS_PRIME, (const uint64_t*) &numbers[first], batch);
+        }
+
+        proto_response_t response;
+        receive_response(client, PROTO_IS_PRIME, &response);
+
+        if (PROTO_OK != response.status)
+        {
+            status = response.status;
+            continue;
+        }
+
+        /* bool is a single byte holding 0 or 1, same as the wire format */
+        receive_all(client->fd, &out[received * PROTO_MAX_BATCH], response.count);
+    }
+
+    return status;
+}
+
+
+proto_status_t client_get_primes_range(client_t *client, size_t begin, size_t end, dynarr_t **out)
+{
+    for (size_t low = begin; low <= end; low += PROTO_MAX_RANGE)
+    {
+        size_t high = end - low < PROTO_MAX_RANGE ? end : low + PROTO_MAX_RANGE - 1;
+
+        proto_response_t response;
+        proto_status_t status = range_request(client, PROTO_RANGE, low, high, &response);
+        if (PROTO_OK != status) return status;
+
+        uint64_t primes[RECEIVE_CHUNK];
+        for (size_t i = 0; i < response.count; i += RECEIVE_CHUNK)
+        {
+            size_t chunk = response.count - i < RECEIVE_CHUNK ? response.count - i : RECEIVE_CHUNK;
+            receive_all(client->fd, primes, chunk * sizeof(uint64_t));
+
+            for (size_t j = 0; j < chunk; ++j)
+            {
+                size_t prime = primes[j];
+                dynarr_append(out, &prime);
+            }
+        }
+
+        if (high == end) break;
+    }
+
+    return PROTO_OK;
+}
+
+
+proto_status_t client_count_primes(client_t *client, size_t begin, size_t end, size_t *out)
+{
+    *out = 0;
+
+    for (size_t low = begin; low <= end; low += PROTO_MAX_COUNT_RANGE)
+    {
+        size_t high = end - low < PROTO_MAX_COUNT_RANGE ? end : low + PROTO_MAX_COUNT_RANGE - 1;
+
+        proto_response_t response;
+        proto_status_t status = range_request(client, PROTO_COUNT, low, high, &response);
+        if (PROTO_OK != status) return status;
+
+        uint64_t count;
+        receive_all(client->fd, &count, sizeof(count));
+        *out += count;
+
+        if (high == end) break;
+    }
+
+    return PROTO_OK;
+}
+
+
+proto_status_t client_calc_PMPR_table(client_t *client, size_t begin, size_t end, dynarr_t **out)
+{
+    proto_response_t response;
+    proto_status_t status = range_request(client, PROTO_PMPR, begin, end, &response);
+    if (PROTO_OK != status) return status;
+
+    for (size_t i = 0; i < response.count; ++i)
+    {
+        uint64_t values[2];
+        receive_all(client->fd, values, sizeof(values));
+
+        pair_t pair = { .first = values[0], .second = values[1] };
+        dynarr_append(out, &pair);
+    }
+
+    return PROTO_OK;
+}
+
+
+static proto_status_t range_request(client_t *client, proto_op_t op, size_t begin, size_t end,
+    proto_response_t *out)
+{
+    uint64_t payload[2] = { begin, end };
+    send_request(client, op, payload, 2);
+    receive_response(client, op, out);
+
+    return out->status;
+}
+
+
+static void send_request(client_t *client, proto_op_t op, const uint64_t *payload, size_t count)
+{
+    proto_request_t request = {
+        .op = op,
+        .tag = client->next_tag++,
+        .count = count
+    };
+
+    send_all(client->fd, &request, sizeof(request));
+    send_all(client->fd, payload, count * sizeof(uint64_t));
+}
+
+
+static void receive_response(client_t *client, proto_op_t op, proto_response_t *out)
+{
+    receive_all(client->fd, out, sizeof(*out));
+    if (out->op != op) exit(EXIT_FAILURE);
+}
+
+
+static void send_all(int fd, const void *data, size_t size)
+{
+    const char *bytes = (const char*) data;
+
+    while (size)
+    {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (-1 == sent)
+        {
+            if (EINTR == errno) continue;
+            exit(EXIT_FAILURE);
+        }
+
+        bytes += sent;
+        size -= sent;
+    }
+}
+
+
+static void receive_all(int fd, void *data, size_t size)
+{
+    char *bytes = (char*) data;
+
+    while (size)
+    {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (0 == received) exit(EXIT_FAILURE);
+        if (-1 == received)
+        {
+            if (EINTR == errno) continue;
+            exit(EXIT_FAILURE);
+        }
+
+        bytes += received;
+        size -= received;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef _CLIENT_H_
+#define _CLIENT_H_
+
+#include "primes.h"
+#include "protocol.h"
+
+/*
+* Connection to the primes daemon, see protocol.h.
+*/
+typedef struct client
+{
+    int       fd;
+    uint32_t  next_tag;
+}
+client_t;
+
+/*
+* Connects to the daemon listening on `socket_path`, returns false if it is not running.
+*/
+bool client_connect(client_t *client, const char *socket_path);
+void client_disconnect(client_t *client);
+
+/*
+* Same as `are_primes_cached`, answered by the daemon.
+* Numbers are sent in pipelined batches of PROTO_MAX_BATCH, all of them before the first answer is read.
+*/
+proto_status_t client_are_primes(client_t *client, const size_t *numbers, size_t count, bool *out);
+
+/*
+* Same as `get_primes_range`, answered by the daemon in chunks of PROTO_MAX_RANGE.
+*/
+proto_status_t client_get_primes_range(client_t *client, size_t begin, size_t end, dynarr_t **out);
+
+/*
+* Amount of primes in [begin, end].
+*/
+proto_status_t client_count_primes(client_t *client, size_t begin, size_t end, size_t *out);
+
+/*
+* Same as `calc_PMPR_table`, answered by the daemon.
+*/
+proto_status_t client_calc_PMPR_table(client_t *client, size_t begin, size_t end, dynarr_t **out);
+
+
+#endif/*_CLIENT_H_*/
@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include "cold_store.h"
+#include "primes.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/falloc.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DATA_SUFFIX ".cold"
+#define INDEX_SUFFIX ".cold.idx"
+#define MAX_COLD_FILENAME_SIZE 64
+
+/*
+* Every cell of a complete segment is NOT_PRIME (10) before primes are restored.
+*/
+#define NOT_PRIME_BYTE 0xaa
+
+/*
+* Encodes odd indices (relative to the region) of primes of complete `region`,
+* returns length of the record stored in `out`, which has to hold a byte per odd number.
+*/
+static size_t encode_region(const char *region, size_t length, uint8_t *out);
+static void decode_region(const uint8_t *record, size_t length, char *region, size_t region_length);
+
+static int open_file(const char *prefix, const char *suffix, bool create);
+static size_t put_varint(uint8_t *out, uint32_t value);
+static size_t get_varint(const uint8_t *in, uint32_t *value);
+
+
+bool cold_store_open(cold_store_t *store, const char *prefix,
+    size_t segment_bytes, size_t segments, bool create)
+{
+    store->index_fd = open_file(prefix, INDEX_SUFFIX, create);
+    if (-1 == store->index_fd) return false;
+
+    store->data_fd = open_file(prefix, DATA_SUFFIX, true);
+
+    size_t index_size = segments * sizeof(cold_entry_t);
+    struct stat st;
+    if (-1 == fstat(store->index_fd, &st)) exit(EXIT_FAILURE);
+    if ((size_t) st.st_size < index_size && -1 == ftruncate(store->index_fd, index_size))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    store->entries = (cold_entry_t*) mmap(NULL,
+        index_size,
+        PROT_READ|PROT_WRITE,
+        MAP_SHARED,
+        store->index_fd,
+        0
+    );
+    if (MAP_FAILED == store->entries) exit(EXIT_FAILURE);
+
+    if (-1 == fstat(store->data_fd, &st)) exit(EXIT_FAILURE);
+    store->data_size = st.st_size;
+    store->segment_bytes = segment_bytes;
+    store->segments = segments;
+
+    return true;
+}
+
+
+void cold_store_close(cold_store_t *store)
+{
+    munmap(store->entries, store->segments * sizeof(cold_entry_t));
+    close(store->index_fd);
+    close(store->data_fd);
+}
+
+
+bool cold_store_freeze(cold_store_t *store, size_t segment, const char *region,
+    int cache_fd, size_t file_offset)
+{
+    cold_entry_t *entry = &store->entries[segment];
+    if (entry->frozen) return true;
+
+    if (0 == entry->length)
+    {
+        uint8_t *record = (uint8_t*) malloc(store->segment_bytes * 4);
+        if (NULL == record) exit(EXIT_FAILURE);
+
+        size_t length = encode_region(region, store->segment_bytes, record);
+        if ((ssize_t) length != pwrite(store->data_fd, record, length, store->data_size))
+        {
+            exit(EXIT_FAILURE);
+        }
+        free(record);
+
+        /* record has to survive a crash before the only other copy is gone */
+        if (-1 == fdatasync(store->data_fd)) exit(EXIT_FAILURE);
+
+        entry->offset = store->data_size;
+        entry->length = length;
+        store->data_size += length;
+
+        /* msync requires page aligned address */
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        char *page = (char*) ((uintptr_t) entry & ~(page_size - 1));
+        if (-1 == msync(page, page_size, MS_SYNC)) exit(EXIT_FAILURE);
+    }
+
+    if (-1 == fallocate(cache_fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, file_offset, store->segment_bytes))
+    {
+        return false;
+    }
+
+    /* crash before this point leaves an all undefined segment, which is sieved again */
+    entry->frozen = 1;
+    return true;
+}
+
+
+void cold_store_thaw(cold_store_t *store, size_t segment, char *region)
+{
+    cold_entry_t *entry = &store->entries[segment];
+
+    uint8_t *record = (uint8_t*) malloc(entry->length);
+    if (NULL == record) exit(EXIT_FAILURE);
+
+    if ((ssize_t) entry->length != pread(store->data_fd, record, entry->length, entry->offset))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    decode_region(record, entry->length, region, store->segment_bytes);
+    free(record);
+
+    /* record is kept, segment is punched again without encoding */
+    entry->frozen = 0;
+}
+
+
+static size_t encode_region(const char *region, size_t length, uint8_t *out)
+{
+    const uint64_t *words = (const uint64_t*) region;
+    size_t size = sizeof(uint32_t); /* amount of primes */
+    uint32_t count = 0;
+    uint32_t previous = 0;
+
+    for (size_t i = 0; i < length / sizeof(uint64_t); ++i)
+    {
+        /* low bit of each PRIME (01) cell */
+        uint64_t primes = words[i] & ~(words[i] >> 1) & 0x5555555555555555ul;
+
+        for (; primes; primes &= primes - 1)
+        {
+            uint32_t idx = i * 32 + __builtin_ctzl(primes) / 2;
+            size += put_varint(&out[size], idx - previous);
+            previous = idx;
+            ++count;
+        }
+    }
+
+    memcpy(out, &count, sizeof(count));
+    return size;
+}
+
+
+static void decode_region(const uint8_t *record, size_t length, char *region, size_t region_length)
+{
+    uint32_t count;
+    memcpy(&count, record, sizeof(count));
+
+    /* decoded aside, so concurrent readers of the region never see a half restored one */
+    char *cells = (char*) malloc(region_length);
+    if (NULL == cells) exit(EXIT_FAILURE);
+
+    memset(cells, NOT_PRIME_BYTE, region_length);
+
+    size_t position = sizeof(count);
+    uint32_t idx = 0;
+    for (uint32_t i = 0; i < count && position < length; ++i)
+    {
+        uint32_t gap;
+        position += get_varint(&record[position], &gap);
+        idx += gap;
+
+        size_t bit = (idx % 4) * 2;
+        cells[idx / 4] = (cells[idx / 4] & ~(VALUES_TOTAL << bit)) | (PRIME << bit);
+    }
+
+    /* region reads as undefined, cells defined meanwhile by others have the same values */
+    uint64_t *words = (uint64_t*) region;
+    const uint64_t *decoded = (const uint64_t*) cells;
+    for (size_t i = 0; i < region_length / sizeof(uint64_t); ++i)
+    {
+        __atomic_fetch_or(&words[i], decoded[i], __ATOMIC_RELAXED);
+    }
+
+    free(cells);
+}
+
+
+static int open_file(const char *prefix, const char *suffix, bool create)
+{
+    char filename[MAX_COLD_FILENAME_SIZE];
+    if (MAX_COLD_FILENAME_SIZE <= snprintf(filename, MAX_COLD_FILENAME_SIZE, "%s%s", prefix, suffix))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = open(filename, create ? O_RDWR|O_CREAT : O_RDWR, S_IRUSR|S_IWUSR);
+    if (-1 == fd && create) exit(EXIT_FAILURE);
+
+    return fd;
+}
+
+
+static size_t put_varint(uint8_t *out, uint32_t value)
+{
+    size_t size = 0;
+    while (value >= 0x80)
+    {
+        out[size++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    out[size++] = value;
+    return size;
+}
+
+
+static size_t get_varint(const uint8_t *in, uint32_t *value)
+{
+    size_t size = 0;
+    uint32_t result = 0;
+    for (unsigned shift = 0; ; shift += 7)
+    {
+        uint8_t byte = in[size++];
+        result |= (uint32_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+
+    *value = result;
+    return size;
+}
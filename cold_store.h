@@ -0,0 +1,61 @@
+#ifndef _COLD_STORE_H_
+#define _COLD_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+* Compressed cold tier of a single cache file.
+* Complete segments are prime-gap encoded into `<prefix>.cold` (LEB128 varints of the
+* distance between consecutive primes in odd numbers, ~1 byte per prime instead of
+* 2 bits per odd number), `<prefix>.cold.idx` maps segment to its record.
+* Frozen segments are punched out of the cache file and restored on demand.
+*/
+typedef struct cold_entry
+{
+    uint64_t  offset;     /* of the record in the data file */
+    uint32_t  length;     /* of the record, zero when segment was never encoded */
+    uint32_t  frozen;     /* segment is punched out of the cache file */
+}
+cold_entry_t;
+
+typedef struct cold_store
+{
+    int       data_fd;
+    int       index_fd;
+    size_t    data_size;      /* records are appended at the end */
+    size_t    segment_bytes;
+    size_t    segments;
+    cold_entry_t *entries;    /* mapped index */
+}
+cold_store_t;
+
+/*
+* Opens cold store of the cache file named `prefix`, creating it only when `create` is set.
+* Returns false if the store does not exist and is not created.
+*/
+bool cold_store_open(cold_store_t *store, const char *prefix,
+    size_t segment_bytes, size_t segments, bool create);
+void cold_store_close(cold_store_t *store);
+
+static inline bool cold_store_is_frozen(const cold_store_t *store, size_t segment)
+{
+    return store->entries[segment].frozen;
+}
+
+/*
+* Encodes complete `region` of the `segment` (unless it is already encoded), makes the record
+* durable and punches the segment at `file_offset` out of `cache_fd`.
+* Returns false if the file system does not support punching holes.
+*/
+bool cold_store_freeze(cold_store_t *store, size_t segment, const char *region,
+    int cache_fd, size_t file_offset);
+
+/*
+* Restores cells of the frozen `segment` into its mapped `region`, which reads as zeros.
+*/
+void cold_store_thaw(cold_store_t *store, size_t segment, char *region);
+
+
+#endif/*_COLD_STORE_H_*/
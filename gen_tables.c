@@ -0,0 +1,127 @@
+/*
+* Build-time generator of the small primes, wheel and reciprocal tables.
+* Output is a c header with table initializers, written to stdout:
+*   ./gen_tables > small_primes_table.h
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+* Amount of odd primes in the table (3 .. 1621).
+*/
+#define SMALL_PRIMES_COUNT 256
+
+/*
+* Wheel of 2 * 3 * 5 * 7, candidates coprime to the modulus are visited only.
+*/
+#define WHEEL_MODULUS 210
+#define WHEEL_SPOKES 48
+
+static bool is_small_prime(uint64_t number);
+static uint64_t gcd(uint64_t a, uint64_t b);
+static uint64_t inverse_mod_word(uint64_t number);
+
+
+int main(void)
+{
+    uint64_t primes[SMALL_PRIMES_COUNT];
+    size_t count = 0;
+
+    for (uint64_t number = 3; count < SMALL_PRIMES_COUNT; number += 2)
+    {
+        if (is_small_prime(number)) primes[count++] = number;
+    }
+
+    uint64_t residues[WHEEL_SPOKES + 1];
+    size_t spokes = 0;
+    for (uint64_t r = 1; r < WHEEL_MODULUS; ++r)
+    {
+        if (1 == gcd(r, WHEEL_MODULUS)) residues[spokes++] = r;
+    }
+    residues[spokes] = WHEEL_MODULUS + 1;
+
+    /* first wheel candidate above the largest table prime */
+    uint64_t largest = primes[SMALL_PRIMES_COUNT - 1];
+    uint64_t start = largest + 1;
+    while (1 != gcd(start, WHEEL_MODULUS)) ++start;
+
+    size_t start_spoke = 0;
+    while (residues[start_spoke] != start % WHEEL_MODULUS) ++start_spoke;
+
+    printf(
+        "/* generated by gen_tables, do not edit */\n"
+        "#ifndef _SMALL_PRIMES_TABLE_H_\n"
+        "#define _SMALL_PRIMES_TABLE_H_\n\n"
+        "#define SMALL_PRIMES_COUNT %d\n"
+        "#define SMALL_PRIMES_LARGEST %" PRIu64 "\n\n"
+        "#define WHEEL_MODULUS %d\n"
+        "#define WHEEL_SPOKES %zu\n"
+        "#define WHEEL_START %" PRIu64 "\n"
+        "#define WHEEL_START_SPOKE %zu\n\n",
+        SMALL_PRIMES_COUNT,
+        largest,
+        WHEEL_MODULUS,
+        spokes,
+        start,
+        start_spoke
+    );
+
+    /* {prime, inverse mod 2^64, UINT64_MAX / prime} */
+    printf("#define SMALL_PRIMES_TABLE { \\\n");
+    for (size_t i = 0; i < count; ++i)
+    {
+        printf("    {%" PRIu64 "u, 0x%016" PRIx64 "u, 0x%016" PRIx64 "u}, \\\n",
+            primes[i], inverse_mod_word(primes[i]), UINT64_MAX / primes[i]);
+    }
+    printf("}\n\n");
+
+    printf("#define WHEEL_INCREMENTS { \\\n");
+    for (size_t i = 0; i < spokes; ++i)
+    {
+        if (i % 16 == 0) printf("   ");
+        printf(" %" PRIu64 ",", residues[i + 1] - residues[i]);
+        if (i % 16 == 15 || i + 1 == spokes) printf(" \\\n");
+    }
+    printf("}\n\n");
+
+    printf("#endif/*_SMALL_PRIMES_TABLE_H_*/\n");
+    return 0;
+}
+
+
+static bool is_small_prime(uint64_t number)
+{
+    for (uint64_t factor = 2; factor * factor <= number; ++factor)
+    {
+        if (number % factor == 0) return false;
+    }
+    return number > 1;
+}
+
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    uint64_t temp;
+    while (b != 0)
+    {
+        temp = a % b;
+
+        a = b;
+        b = temp;
+    }
+    return a;
+}
+
+
+static uint64_t inverse_mod_word(uint64_t number)
+{
+    uint64_t inverse = number;
+    for (int i = 0; i < 5; ++i)
+    {
+        inverse *= 2 - number * inverse;
+    }
+    return inverse;
+}
@@ -0,0 +1,226 @@
+#include "hash_store.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HASH_STORE_MAGIC 0x31534850534d5250ul /* "PRMSPHS1" */
+#define INITIAL_CAPACITY 4096
+#define MAX_TEMP_FILENAME_SIZE 256
+
+typedef struct hash_store_header
+{
+    uint64_t  magic;
+    uint64_t  value_size;
+    uint64_t  capacity;   /* power of two */
+    uint64_t  count;
+}
+hash_store_header_t;
+
+/*
+* Maps `filename` (creating one with `capacity` slots if it does not exist).
+*/
+static void map_store(hash_store_t *store, const char *filename, size_t capacity);
+static void unmap_store(hash_store_t *store);
+
+/*
+* Rehashes the table into a file of double capacity, which then replaces the current one.
+*/
+static void grow_store(hash_store_t *store);
+
+static hash_store_header_t *get_header(const hash_store_t *store);
+static char *get_slot(const hash_store_t *store, size_t idx);
+static size_t hash_key(uint64_t key, size_t capacity);
+
+/*
+* Finds slot holding the `key`, or the empty slot where the key belongs.
+*/
+static char *probe(const hash_store_t *store, uint64_t key);
+
+
+void hash_store_open(hash_store_t *store, const char *filename, size_t value_size)
+{
+    store->value_size = value_size;
+    store->slot_size = (sizeof(uint64_t) + value_size + 7) & ~7ul;
+    store->filename = strdup(filename);
+    if (NULL == store->filename) exit(EXIT_FAILURE);
+
+    map_store(store, filename, INITIAL_CAPACITY);
+
+    /* slots of a foreign or truncated file would be probed out of the mapping */
+    hash_store_header_t *header = get_header(store);
+    if (header->magic != HASH_STORE_MAGIC
+        || header->value_size != value_size
+        || header->capacity < 2
+        || (header->capacity & (header->capacity - 1))
+        || 4 * header->count > 3 * header->capacity
+        || (store->map_size - sizeof(hash_store_header_t)) / store->slot_size < header->capacity)
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void hash_store_close(hash_store_t *store)
+{
+    unmap_store(store);
+    free(store->filename);
+    store->filename = NULL;
+}
+
+
+const void *hash_store_find(const hash_store_t *store, uint64_t key)
+{
+    char *slot = probe(store, key);
+    if (*(uint64_t*) slot != key) return NULL;
+
+    return slot + sizeof(uint64_t);
+}
+
+
+void hash_store_insert(hash_store_t *store, uint64_t key, const void *value)
+{
+    hash_store_header_t *header = get_header(store);
+    if (4 * (header->count + 1) > 3 * header->capacity)
+    {
+        grow_store(store);
+        header = get_header(store);
+    }
+
+    char *slot = probe(store, key);
+    memcpy(slot + sizeof(uint64_t), value, store->value_size);
+
+    if (*(uint64_t*) slot != key)
+    {
+        *(uint64_t*) slot = key;
+        ++header->count;
+    }
+}
+
+
+size_t hash_store_size(const hash_store_t *store)
+{
+    return get_header(store)->count;
+}
+
+
+static void map_store(hash_store_t *store, const char *filename, size_t capacity)
+{
+    int fd = open(filename, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+    if (-1 == fd) exit(EXIT_FAILURE);
+
+    struct stat st;
+    if (-1 == fstat(fd, &st)) exit(EXIT_FAILURE);
+
+    size_t size = st.st_size;
+    bool created = (0 == size);
+    if (created)
+    {
+        size = sizeof(hash_store_header_t) + capacity * store->slot_size;
+        if (-1 == ftruncate(fd, size)) exit(EXIT_FAILURE);
+    }
+    if (size < sizeof(hash_store_header_t)) exit(EXIT_FAILURE);
+
+    char *map = (char*) mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == map)
+    {
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+
+    store->fd = fd;
+    store->map = map;
+    store->map_size = size;
+
+    if (created)
+    {
+        *get_header(store) = (hash_store_header_t){
+            .magic = HASH_STORE_MAGIC,
+            .value_size = store->value_size,
+            .capacity = capacity,
+            .count = 0
+        };
+    }
+}
+
+
+static void unmap_store(hash_store_t *store)
+{
+    if (store->map) munmap(store->map, store->map_size);
+    if (store->fd >= 0) close(store->fd);
+
+    store->map = NULL;
+    store->fd = -1;
+}
+
+
+static void grow_store(hash_store_t *store)
+{
+    char temp_filename[MAX_TEMP_FILENAME_SIZE];
+    if (MAX_TEMP_FILENAME_SIZE <= snprintf(temp_filename, MAX_TEMP_FILENAME_SIZE, "%s.tmp", store->filename))
+    {
+        exit(EXIT_FAILURE);
+    }
+    unlink(temp_filename);
+
+    hash_store_t grown = *store;
+    map_store(&grown, temp_filename, 2 * get_header(store)->capacity);
+
+    size_t capacity = get_header(store)->capacity;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        char *slot = get_slot(store, i);
+        uint64_t key = *(uint64_t*) slot;
+        if (0 == key) continue;
+
+        memcpy(probe(&grown, key), slot, store->slot_size);
+        ++get_header(&grown)->count;
+    }
+
+    if (-1 == msync(grown.map, grown.map_size, MS_SYNC)) exit(EXIT_FAILURE);
+    if (-1 == rename(temp_filename, store->filename)) exit(EXIT_FAILURE);
+
+    unmap_store(store);
+    store->fd = grown.fd;
+    store->map = grown.map;
+    store->map_size = grown.map_size;
+}
+
+
+static hash_store_header_t *get_header(const hash_store_t *store)
+{
+    return (hash_store_header_t*) store->map;
+}
+
+
+static char *get_slot(const hash_store_t *store, size_t idx)
+{
+    return store->map + sizeof(hash_store_header_t) + idx * store->slot_size;
+}
+
+
+static size_t hash_key(uint64_t key, size_t capacity)
+{
+    /* fibonacci hashing, capacity is a power of two */
+    return (key * 0x9e3779b97f4a7c15ul) >> (64 - __builtin_ctzl(capacity));
+}
+
+
+static char *probe(const hash_store_t *store, uint64_t key)
+{
+    size_t capacity = get_header(store)->capacity;
+    size_t idx = hash_key(key, capacity);
+
+    for (;;)
+    {
+        char *slot = get_slot(store, idx);
+        uint64_t slot_key = *(uint64_t*) slot;
+        if (slot_key == key || slot_key == 0) return slot;
+
+        idx = (idx + 1) & (capacity - 1);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef _HASH_STORE_H_
+#define _HASH_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+* Persistent hash table mapped from a file.
+* Open addressing with linear probing, keys are non-zero 64-bit numbers,
+* values are fixed size blobs. Table doubles its capacity (and the file)
+* once it gets 3/4 full.
+*/
+typedef struct hash_store
+{
+    int       fd;
+    char      *filename;
+    size_t    value_size;
+    size_t    slot_size;
+    size_t    map_size;
+    char      *map;       /* header followed by slots */
+}
+hash_store_t;
+
+/*
+* Opens or creates store file `filename` for values of `value_size` bytes.
+*/
+void hash_store_open(hash_store_t *store, const char *filename, size_t value_size);
+void hash_store_close(hash_store_t *store);
+
+/*
+* Returns pointer to the value stored for the `key` or NULL if there is none.
+* Pointer is valid until next insertion.
+*/
+const void *hash_store_find(const hash_store_t *store, uint64_t key);
+
+/*
+* Inserts `value` for the `key`, overwriting previous one.
+*/
+void hash_store_insert(hash_store_t *store, uint64_t key, const void *value);
+
+/*
+* Amount of stored entries.
+*/
+size_t hash_store_size(const hash_store_t *store);
+
+
+#endif/*_HASH_STORE_H_*/
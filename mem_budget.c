@@ -0,0 +1,483 @@
+#include "mem_budget.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_REGIONS 64
+
+/*
+* Index of no region, ends the LRU list and marks free slots of the indexes.
+*/
+#define NO_REGION SIZE_MAX
+
+/*
+* Keys regions are indexed by.
+*/
+typedef enum region_key
+{
+    KEY_RANGE,  /* file, offset and length */
+    KEY_ADDR
+}
+region_key_t;
+
+/*
+* Region to shed, called under the lock: the least recently used one past the budget,
+* any unused one without a budget. Returns NO_REGION if none has to go.
+*/
+static size_t pick_victim(const mem_budget_t *budget);
+
+/*
+* Sheds regions picked by `pick_victim` one by one and cools the rest, called without the lock.
+* Each victim is removed from the pool under the lock, then written back and unmapped outside it.
+*/
+static void enforce_budget(mem_budget_t *budget);
+
+/*
+* Hints unused regions above 3/4 of the budget with MADV_COLD, called under the lock.
+*/
+static void cool_regions(mem_budget_t *budget);
+
+/*
+* Removes region `idx` from the pool and returns it, the last region takes its place.
+*/
+static mapped_region_t detach_region(mem_budget_t *budget, size_t idx);
+
+/*
+* Appends region `idx` to the tail of the LRU list / takes it out of the list.
+*/
+static void link_region(mem_budget_t *budget, size_t idx);
+static void unlink_region(mem_budget_t *budget, size_t idx);
+
+static size_t hash_region(const mapped_region_t *region, region_key_t key);
+static bool same_region(const mapped_region_t *a, const mapped_region_t *b, region_key_t key);
+static size_t *get_index(mem_budget_t *budget, region_key_t key);
+
+/*
+* Slot of the `key` index holding the region equal to `probe`, or the free slot ending its probe sequence.
+* The index must not be empty.
+*/
+static size_t find_slot(mem_budget_t *budget, region_key_t key, const mapped_region_t *probe);
+
+/*
+* Region equal to `probe` by the `key`, NO_REGION if there is none.
+*/
+static size_t find_region(mem_budget_t *budget, region_key_t key, const mapped_region_t *probe);
+
+/*
+* Adds region `idx` to both indexes, grows them first to stay at most half full.
+*/
+static void index_region(mem_budget_t *budget, size_t idx);
+
+/*
+* Frees `slot` of the `key` index, following entries of its probe sequence are shifted back.
+*/
+static void free_slot(mem_budget_t *budget, region_key_t key, size_t slot);
+
+
+void mem_budget_init(mem_budget_t *budget)
+{
+    *budget = (mem_budget_t){
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .lru_head = NO_REGION,
+        .lru_tail = NO_REGION,
+        .lru_warm = NO_REGION
+    };
+}
+
+
+void mem_budget_close(mem_budget_t *budget)
+{
+    for (size_t i = 0; i < budget->count; ++i)
+    {
+        munmap(budget->regions[i].addr, budget->regions[i].length);
+    }
+
+    free(budget->regions);
+    free(budget->by_range);
+    free(budget->by_addr);
+    budget->regions = NULL;
+    budget->by_range = budget->by_addr = NULL;
+    budget->count = budget->capacity = budget->slots = 0;
+    budget->mapped = budget->cold_bytes = 0;
+    budget->lru_head = budget->lru_tail = budget->lru_warm = NO_REGION;
+}
+
+
+void mem_budget_set_limit(mem_budget_t *budget, size_t limit)
+{
+    pthread_mutex_lock(&budget->lock);
+    budget->limit = limit;
+    pthread_mutex_unlock(&budget->lock);
+
+    /* without a budget unused regions are not kept, the ones in use go on release */
+    enforce_budget(budget);
+}
+
+
+char *mem_budget_acquire(mem_budget_t *budget, size_t file_idx, size_t file_offset,
+    size_t length, int fd)
+{
+    pthread_mutex_lock(&budget->lock);
+
+    mapped_region_t probe = { .file_idx = file_idx, .file_offset = file_offset, .length = length };
+    size_t idx = find_region(budget, KEY_RANGE, &probe);
+    if (NO_REGION != idx)
+    {
+        mapped_region_t *region = &budget->regions[idx];
+
+        if (0 == region->pins) unlink_region(budget, idx);
+        if (region->cold)
+        {
+            region->cold = false;
+            budget->cold_bytes -= length;
+        }
+        ++region->pins;
+
+        pthread_mutex_unlock(&budget->lock);
+        return region->addr;
+    }
+
+    if (budget->count == budget->capacity)
+    {
+        size_t capacity = budget->capacity ? 2 * budget->capacity : INITIAL_REGIONS;
+        mapped_region_t *regions = (mapped_region_t*) realloc(budget->regions, capacity * sizeof(mapped_region_t));
+        if (NULL == regions) exit(EXIT_FAILURE);
+
+        budget->regions = regions;
+        budget->capacity = capacity;
+    }
+
+    char *addr = (char*) mmap(NULL,
+        length,
+        PROT_READ|PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        file_offset
+    );
+    if (MAP_FAILED == addr) exit(EXIT_FAILURE);
+
+    budget->regions[budget->count] = (mapped_region_t){
+        .file_idx = file_idx,
+        .file_offset = file_offset,
+        .length = length,
+        .addr = addr,
+        .pins = 1,
+        .prev = NO_REGION,
+        .next = NO_REGION
+    };
+    index_region(budget, budget->count);
+    ++budget->count;
+    budget->mapped += length;
+
+    pthread_mutex_unlock(&budget->lock);
+
+    enforce_budget(budget);
+    return addr;
+}
+
+
+bool mem_budget_release(mem_budget_t *budget, char *addr)
+{
+    pthread_mutex_lock(&budget->lock);
+
+    mapped_region_t probe = { .addr = addr };
+    size_t idx = find_region(budget, KEY_ADDR, &probe);
+    if (NO_REGION == idx)
+    {
+        pthread_mutex_unlock(&budget->lock);
+        return false;
+    }
+
+    if (0 == --budget->regions[idx].pins) link_region(budget, idx);
+
+    pthread_mutex_unlock(&budget->lock);
+
+    enforce_budget(budget);
+    return true;
+}
+
+
+bool mem_budget_is_pinned(const mem_budget_t *budget, size_t file_idx, size_t file_offset,
+    size_t length, const char *own)
+{
+    for (size_t i = 0; i < budget->count; ++i)
+    {
+        const mapped_region_t *region = &budget->regions[i];
+        if (region->file_idx != file_idx) continue;
+        if (region->file_offset >= file_offset + length || file_offset >= region->file_offset + region->length)
+        {
+            continue;
+        }
+
+        if (region->pins > (region->addr == own ? 1 : 0)) return true;
+    }
+    return false;
+}
+
+
+void mem_budget_usage(mem_budget_t *budget, mem_usage_t *out)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    unsigned char *residency = NULL;
+    size_t residency_size = 0;
+
+    pthread_mutex_lock(&budget->lock);
+
+    *out = (mem_usage_t){
+        .limit = budget->limit,
+        .mapped = budget->mapped,
+        .regions = budget->count,
+        .cooled = budget->cooled,
+        .shed = budget->shed
+    };
+
+    for (size_t i = 0; i < budget->count; ++i)
+    {
+        const mapped_region_t *region = &budget->regions[i];
+        size_t pages = (region->length + page_size - 1) / page_size;
+
+        if (pages > residency_size)
+        {
+            residency = (unsigned char*) realloc(residency, pages);
+            if (NULL == residency) exit(EXIT_FAILURE);
+            residency_size = pages;
+        }
+
+        if (-1 == mincore(region->addr, region->length, residency)) continue;
+
+        for (size_t p = 0; p < pages; ++p)
+        {
+            if (residency[p] & 1) out->resident += page_size;
+        }
+
+        if (region->pins) out->pinned += region->length;
+    }
+
+    pthread_mutex_unlock(&budget->lock);
+    free(residency);
+}
+
+
+static size_t pick_victim(const mem_budget_t *budget)
+{
+    if (budget->limit && budget->mapped <= budget->limit) return NO_REGION;
+    return budget->lru_head;
+}
+
+
+static void enforce_budget(mem_budget_t *budget)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&budget->lock);
+
+        size_t idx = pick_victim(budget);
+        if (NO_REGION == idx)
+        {
+            cool_regions(budget);
+            pthread_mutex_unlock(&budget->lock);
+            return;
+        }
+
+        bool page_out = 0 != budget->limit;
+        if (page_out) budget->shed += budget->regions[idx].length;
+        mapped_region_t region = detach_region(budget, idx);
+
+        pthread_mutex_unlock(&budget->lock);
+
+        if (page_out)
+        {
+            /* dirty pages of a shared mapping stay in the page cache after munmap, write them first */
+            msync(region.addr, region.length, MS_SYNC);
+#ifdef MADV_PAGEOUT
+            madvise(region.addr, region.length, MADV_PAGEOUT);
+#endif
+        }
+        munmap(region.addr, region.length);
+    }
+}
+
+
+static void cool_regions(mem_budget_t *budget)
+{
+    if (0 == budget->limit) return;
+
+    /* reclaim prefers cooled pages of the pool over memory of other services */
+    size_t soft_limit = budget->limit - budget->limit / 4;
+    while (budget->mapped - budget->cold_bytes > soft_limit && NO_REGION != budget->lru_warm)
+    {
+        mapped_region_t *region = &budget->regions[budget->lru_warm];
+
+#ifdef MADV_COLD
+        madvise(region->addr, region->length, MADV_COLD);
+#endif
+        region->cold = true;
+        budget->cold_bytes += region->length;
+        budget->cooled += region->length;
+        budget->lru_warm = region->next;
+    }
+}
+
+
+static mapped_region_t detach_region(mem_budget_t *budget, size_t idx)
+{
+    mapped_region_t region = budget->regions[idx];
+    if (0 == region.pins) unlink_region(budget, idx);
+
+    free_slot(budget, KEY_RANGE, find_slot(budget, KEY_RANGE, &region));
+    free_slot(budget, KEY_ADDR, find_slot(budget, KEY_ADDR, &region));
+
+    budget->mapped -= region.length;
+    if (region.cold) budget->cold_bytes -= region.length;
+
+    size_t last = --budget->count;
+    if (idx == last) return region;
+
+    /* indexes and links to the moved region follow it */
+    get_index(budget, KEY_RANGE)[find_slot(budget, KEY_RANGE, &budget->regions[last])] = idx;
+    get_index(budget, KEY_ADDR)[find_slot(budget, KEY_ADDR, &budget->regions[last])] = idx;
+
+    mapped_region_t *moved = &budget->regions[idx];
+    *moved = budget->regions[last];
+    if (0 == moved->pins)
+    {
+        if (NO_REGION != moved->prev) budget->regions[moved->prev].next = idx;
+        else budget->lru_head = idx;
+
+        if (NO_REGION != moved->next) budget->regions[moved->next].prev = idx;
+        else budget->lru_tail = idx;
+
+        if (budget->lru_warm == last) budget->lru_warm = idx;
+    }
+
+    return region;
+}
+
+
+static void link_region(mem_budget_t *budget, size_t idx)
+{
+    mapped_region_t *region = &budget->regions[idx];
+
+    region->prev = budget->lru_tail;
+    region->next = NO_REGION;
+
+    if (NO_REGION != budget->lru_tail) budget->regions[budget->lru_tail].next = idx;
+    else budget->lru_head = idx;
+    budget->lru_tail = idx;
+
+    /* released regions are warm, they follow all the cold ones */
+    if (NO_REGION == budget->lru_warm) budget->lru_warm = idx;
+}
+
+
+static void unlink_region(mem_budget_t *budget, size_t idx)
+{
+    mapped_region_t *region = &budget->regions[idx];
+
+    if (NO_REGION != region->prev) budget->regions[region->prev].next = region->next;
+    else budget->lru_head = region->next;
+
+    if (NO_REGION != region->next) budget->regions[region->next].prev = region->prev;
+    else budget->lru_tail = region->prev;
+
+    if (budget->lru_warm == idx) budget->lru_warm = region->next;
+}
+
+
+static size_t hash_region(const mapped_region_t *region, region_key_t key)
+{
+    size_t hash = KEY_ADDR == key ? (size_t) region->addr
+        : (region->file_idx * 0x9e3779b97f4a7c15ul) ^ region->file_offset ^ (region->length << 40);
+
+    /* offsets and addresses are page aligned, mix high bits down (murmur3 finalizer) */
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdul;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ul;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+static bool same_region(const mapped_region_t *a, const mapped_region_t *b, region_key_t key)
+{
+    if (KEY_ADDR == key) return a->addr == b->addr;
+    return a->file_idx == b->file_idx && a->file_offset == b->file_offset && a->length == b->length;
+}
+
+
+static size_t *get_index(mem_budget_t *budget, region_key_t key)
+{
+    return KEY_ADDR == key ? budget->by_addr : budget->by_range;
+}
+
+
+static size_t find_slot(mem_budget_t *budget, region_key_t key, const mapped_region_t *probe)
+{
+    const size_t *index = get_index(budget, key);
+    size_t mask = budget->slots - 1;
+
+    for (size_t slot = hash_region(probe, key) & mask; ; slot = (slot + 1) & mask)
+    {
+        size_t idx = index[slot];
+        if (NO_REGION == idx || same_region(&budget->regions[idx], probe, key)) return slot;
+    }
+}
+
+
+static size_t find_region(mem_budget_t *budget, region_key_t key, const mapped_region_t *probe)
+{
+    if (0 == budget->slots) return NO_REGION;
+    return get_index(budget, key)[find_slot(budget, key, probe)];
+}
+
+
+static void index_region(mem_budget_t *budget, size_t idx)
+{
+    if (2 * (budget->count + 1) > budget->slots)
+    {
+        size_t slots = budget->slots ? 2 * budget->slots : 2 * INITIAL_REGIONS;
+        free(budget->by_range);
+        free(budget->by_addr);
+
+        budget->by_range = (size_t*) malloc(slots * sizeof(size_t));
+        budget->by_addr = (size_t*) malloc(slots * sizeof(size_t));
+        if (!budget->by_range || !budget->by_addr) exit(EXIT_FAILURE);
+
+        memset(budget->by_range, 0xff, slots * sizeof(size_t));
+        memset(budget->by_addr, 0xff, slots * sizeof(size_t));
+        budget->slots = slots;
+
+        /* regions before `idx` are indexed again */
+        for (size_t i = 0; i < idx; ++i)
+        {
+            index_region(budget, i);
+        }
+    }
+
+    const mapped_region_t *region = &budget->regions[idx];
+    budget->by_range[find_slot(budget, KEY_RANGE, region)] = idx;
+    budget->by_addr[find_slot(budget, KEY_ADDR, region)] = idx;
+}
+
+
+static void free_slot(mem_budget_t *budget, region_key_t key, size_t slot)
+{
+    size_t *index = get_index(budget, key);
+    size_t mask = budget->slots - 1;
+
+    for (size_t next = (slot + 1) & mask; NO_REGION != index[next]; next = (next + 1) & mask)
+    {
+        /* an entry may fill the hole unless its home slot lies between the hole and itself */
+        size_t home = hash_region(&budget->regions[index[next]], key) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask))
+        {
+            index[slot] = index[next];
+            slot = next;
+        }
+    }
+
+    index[slot] = NO_REGION;
+}
@@ -0,0 +1,108 @@
+#ifndef _MEM_BUDGET_H_
+#define _MEM_BUDGET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*
+* Pool of mapped regions of cache files kept within a budget of mapped bytes.
+* The budget counts whole regions, not their resident pages, so memory actually
+* taken may be lower (see `mem_budget_usage`), but never above the budget for long.
+* Regions are mapped once and reused by later requests of the same file range,
+* unused ones are shed least recently used first: past 3/4 of the budget they are
+* hinted with MADV_COLD, past the budget they are written back, paged out and unmapped.
+* Regions in use (pinned) are never shed, so the budget may be exceeded temporarily.
+* Without a budget regions are kept only while they are in use.
+* Regions are indexed by their file range and by their address (open addressing,
+* linear probing), so acquiring and releasing one does not walk the pool.
+*/
+typedef struct mapped_region
+{
+    size_t    file_idx;
+    size_t    file_offset;
+    size_t    length;
+    char      *addr;
+    size_t    pins;       /* users currently holding the region */
+    bool      cold;       /* already hinted with MADV_COLD */
+    size_t    prev;       /* neighbours in the LRU list of unused regions */
+    size_t    next;
+}
+mapped_region_t;
+
+typedef struct mem_budget
+{
+    pthread_mutex_t lock;
+    size_t    limit;      /* bytes, zero means no budget */
+    size_t    mapped;     /* bytes of all regions */
+    size_t    count;
+    size_t    capacity;
+    mapped_region_t *regions;
+    size_t    *by_range;  /* indexes of regions by file range, NO_REGION marks free slots */
+    size_t    *by_addr;   /* indexes of regions by address */
+    size_t    slots;      /* of each index, a power of two above twice the regions */
+    size_t    lru_head;   /* least recently released region not in use */
+    size_t    lru_tail;
+    size_t    lru_warm;   /* first one not hinted with MADV_COLD, cold ones precede it */
+    size_t    cold_bytes; /* of regions hinted with MADV_COLD */
+    size_t    cooled;     /* bytes hinted with MADV_COLD so far */
+    size_t    shed;       /* bytes paged out and unmapped so far */
+}
+mem_budget_t;
+
+/*
+* Usage of the budget, in the spirit of memory.current / memory.max of a cgroup.
+*/
+typedef struct mem_usage
+{
+    size_t    limit;
+    size_t    mapped;     /* bytes of regions mapped by the pool */
+    size_t    resident;   /* bytes of those regions present in memory */
+    size_t    pinned;     /* bytes of regions in use */
+    size_t    regions;
+    size_t    cooled;
+    size_t    shed;
+}
+mem_usage_t;
+
+void mem_budget_init(mem_budget_t *budget);
+
+/*
+* Unmaps all regions, they must not be in use.
+*/
+void mem_budget_close(mem_budget_t *budget);
+
+/*
+* Sets budget to `limit` mapped bytes (zero disables it) and sheds regions above it.
+*/
+void mem_budget_set_limit(mem_budget_t *budget, size_t limit);
+
+/*
+* Returns pinned mapping of `length` bytes at `file_offset` of the cache file `file_idx`,
+* mapped from `fd` unless the pool holds it already.
+*/
+char *mem_budget_acquire(mem_budget_t *budget, size_t file_idx, size_t file_offset,
+    size_t length, int fd);
+
+/*
+* Unpins region returned by `mem_budget_acquire`, returns false if `addr` is not
+* a region of the pool. Regions released while the budget is disabled are unmapped.
+*/
+bool mem_budget_release(mem_budget_t *budget, char *addr);
+
+/*
+* Whether a region of the cache file `file_idx` overlapping `length` bytes at `file_offset`
+* is in use, one pin of the region at `own` (NULL for none) aside. Has to be called under
+* the lock of the `budget`, which keeps regions from being acquired until it is released.
+*/
+bool mem_budget_is_pinned(const mem_budget_t *budget, size_t file_idx, size_t file_offset,
+    size_t length, const char *own);
+
+/*
+* Collects usage of the budget, residency of the regions is queried by mincore.
+*/
+void mem_budget_usage(mem_budget_t *budget, mem_usage_t *out);
+
+
+#endif/*_MEM_BUDGET_H_*/
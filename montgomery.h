@@ -0,0 +1,109 @@
+#ifndef _MONTGOMERY_H_
+#define _MONTGOMERY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+* Montgomery modular arithmetic for odd 64-bit moduli, R = 2^64.
+* Numbers are kept in form (x * R mod mod), so modular multiplication
+* costs two 64x64 multiplications and no division.
+*/
+typedef struct montgomery
+{
+    uint64_t mod;
+    uint64_t inverse;   /* mod^-1 mod 2^64 */
+    uint64_t one;       /* R mod mod, i.e. 1 in montgomery form */
+    uint64_t r2;        /* R^2 mod mod */
+}
+montgomery_t;
+
+
+static inline void montgomery_init(montgomery_t *ctx, uint64_t mod)
+{
+    uint64_t inverse = mod;
+    for (int i = 0; i < 5; ++i)
+    {
+        inverse *= 2 - mod * inverse;
+    }
+
+    ctx->mod = mod;
+    ctx->inverse = inverse;
+    ctx->one = (uint64_t) (((unsigned __int128) 1 << 64) % mod);
+    ctx->r2 = (uint64_t) (((unsigned __int128) ctx->one * ctx->one) % mod);
+}
+
+/*
+* Returns (value * R^-1 mod mod), value has to be below (mod * R).
+*/
+static inline uint64_t montgomery_reduce(const montgomery_t *ctx, unsigned __int128 value)
+{
+    uint64_t m = (uint64_t) value * ctx->inverse;
+    uint64_t mn_hi = (uint64_t) (((unsigned __int128) m * ctx->mod) >> 64);
+    uint64_t value_hi = (uint64_t) (value >> 64);
+
+    return value_hi >= mn_hi ? value_hi - mn_hi : value_hi - mn_hi + ctx->mod;
+}
+
+static inline uint64_t montgomery_mul(const montgomery_t *ctx, uint64_t a, uint64_t b)
+{
+    return montgomery_reduce(ctx, (unsigned __int128) a * b);
+}
+
+static inline uint64_t montgomery_to(const montgomery_t *ctx, uint64_t value)
+{
+    return montgomery_mul(ctx, value % ctx->mod, ctx->r2);
+}
+
+static inline uint64_t montgomery_from(const montgomery_t *ctx, uint64_t value)
+{
+    return montgomery_reduce(ctx, value);
+}
+
+/*
+* Modular exponentiation, `base` and result are in montgomery form.
+*/
+static inline uint64_t montgomery_pow(const montgomery_t *ctx, uint64_t base, uint64_t exp)
+{
+    uint64_t product = ctx->one;
+    while (exp > 0)
+    {
+        if (exp & 1)
+        {
+            product = montgomery_mul(ctx, product, base);
+        }
+        base = montgomery_mul(ctx, base, base);
+        exp >>= 1;
+    }
+    return product;
+}
+
+/*
+* Raises single `base` to `count` exponents at once, sharing the squaring chain
+* of the base between all of them. `base` and results are in montgomery form.
+*/
+static inline void montgomery_pow_multi(const montgomery_t *ctx, uint64_t base,
+    const uint64_t *exps, size_t count, uint64_t *out)
+{
+    uint64_t remaining = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = ctx->one;
+        remaining |= exps[i];
+    }
+
+    for (unsigned bit = 0; remaining; ++bit, remaining >>= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ((exps[i] >> bit) & 1)
+            {
+                out[i] = montgomery_mul(ctx, out[i], base);
+            }
+        }
+        base = montgomery_mul(ctx, base, base);
+    }
+}
+
+
+#endif/*_MONTGOMERY_H_*/
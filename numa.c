@@ -0,0 +1,119 @@
+#define _GNU_SOURCE
+#include "numa.h"
+
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYSFS_NODES "/sys/devices/system/node"
+#define MAX_CPULIST_SIZE 4096
+#define MAX_PATH_SIZE 128
+
+/*
+* Parses cpulist format ("0-3,8,10-11") into cpu bitmask of the `node`.
+*/
+static bool parse_cpulist(const char *list, numa_node_t *node);
+static bool read_node(int id, numa_node_t *node);
+static void add_cpu(numa_node_t *node, size_t cpu);
+
+
+void numa_load_topology(numa_topology_t *topology)
+{
+    topology->count = 0;
+
+    for (int id = 0; id < MAX_NUMA_NODES; ++id)
+    {
+        numa_node_t *node = &topology->nodes[topology->count];
+        if (read_node(id, node) && node->cpu_count > 0)
+        {
+            ++topology->count;
+        }
+    }
+
+    if (topology->count > 0) return;
+
+    /* no NUMA information, single node with every online cpu */
+    numa_node_t *node = &topology->nodes[0];
+    memset(node, 0, sizeof(numa_node_t));
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < cpus && cpu < MAX_NUMA_CPUS; ++cpu)
+    {
+        add_cpu(node, cpu);
+    }
+    topology->count = 1;
+}
+
+
+bool numa_pin_thread(const numa_node_t *node)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (size_t cpu = 0; cpu < MAX_NUMA_CPUS && cpu < CPU_SETSIZE; ++cpu)
+    {
+        if ((node->cpus[cpu / 64] >> (cpu % 64)) & 1) CPU_SET(cpu, &set);
+    }
+
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+
+static bool read_node(int id, numa_node_t *node)
+{
+    char path[MAX_PATH_SIZE];
+    snprintf(path, MAX_PATH_SIZE, SYSFS_NODES "/node%d/cpulist", id);
+
+    FILE *file = fopen(path, "r");
+    if (NULL == file) return false;
+
+    char list[MAX_CPULIST_SIZE];
+    bool read = (NULL != fgets(list, MAX_CPULIST_SIZE, file));
+    fclose(file);
+
+    memset(node, 0, sizeof(numa_node_t));
+    node->id = id;
+
+    return read && parse_cpulist(list, node);
+}
+
+
+static bool parse_cpulist(const char *list, numa_node_t *node)
+{
+    const char *c = list;
+
+    while (*c && *c != '\n')
+    {
+        char *next;
+        unsigned long first = strtoul(c, &next, 10);
+        if (next == c) return false;
+
+        unsigned long last = first;
+        c = next;
+
+        if (*c == '-')
+        {
+            last = strtoul(c + 1, &next, 10);
+            c = next;
+        }
+
+        for (unsigned long cpu = first; cpu <= last && cpu < MAX_NUMA_CPUS; ++cpu)
+        {
+            add_cpu(node, cpu);
+        }
+
+        if (*c == ',') ++c;
+    }
+
+    return true;
+}
+
+
+static void add_cpu(numa_node_t *node, size_t cpu)
+{
+    node->cpus[cpu / 64] |= 1ul << (cpu % 64);
+    ++node->cpu_count;
+}
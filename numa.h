@@ -0,0 +1,41 @@
+#ifndef _NUMA_H_
+#define _NUMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_NUMA_NODES 64
+#define MAX_NUMA_CPUS 1024
+
+/*
+* Single NUMA node with its cpus, bit per cpu id.
+*/
+typedef struct numa_node
+{
+    int       id;
+    size_t    cpu_count;
+    uint64_t  cpus[MAX_NUMA_CPUS / 64];
+}
+numa_node_t;
+
+/*
+* Machine topology read from sysfs.
+* Machines without NUMA (or without sysfs) are described as a single node with all cpus.
+*/
+typedef struct numa_topology
+{
+    size_t      count;
+    numa_node_t nodes[MAX_NUMA_NODES];
+}
+numa_topology_t;
+
+void numa_load_topology(numa_topology_t *topology);
+
+/*
+* Restricts calling thread to the cpus of the `node`.
+*/
+bool numa_pin_thread(const numa_node_t *node);
+
+
+#endif/*_NUMA_H_*/
@@ -0,0 +1,52 @@
+#include "page_state.h"
+
+#define PAGE_STATE_MAGIC 0x31474150534d5250ul /* "PRMSPAG1" */
+
+
+bool page_states_open(page_states_t *states, const char *filename,
+    size_t page_size, size_t pages, bool writable)
+{
+    if (!sidecar_open(&states->sidecar, filename, PAGE_STATE_MAGIC, page_size, pages,
+        sizeof(uint32_t), writable))
+    {
+        return false;
+    }
+
+    states->entries = (uint32_t*) (states->sidecar.map + SIDECAR_HEADER_SIZE);
+    return true;
+}
+
+
+void page_states_close(page_states_t *states)
+{
+    sidecar_close(&states->sidecar);
+    states->entries = NULL;
+}
+
+
+void page_states_complete(page_states_t *states, size_t page, uint32_t primes)
+{
+    uint32_t entry = ((uint32_t) PAGE_COMPLETE << PAGE_STATE_SHIFT) | (primes & PAGE_PRIMES_MASK);
+    __atomic_store_n(&states->entries[page], entry, __ATOMIC_RELEASE);
+}
+
+
+void page_states_touch(page_states_t *states, size_t page)
+{
+    /* complete page must not go back, so only an empty one is changed */
+    uint32_t expected = (uint32_t) PAGE_EMPTY << PAGE_STATE_SHIFT;
+    uint32_t entry = (uint32_t) PAGE_PARTIAL << PAGE_STATE_SHIFT;
+    __atomic_compare_exchange_n(&states->entries[page], &expected, entry,
+        false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+
+void page_states_clear(page_states_t *states, size_t page, size_t count)
+{
+    for (size_t p = page; p < page + count; ++p)
+    {
+        __atomic_store_n(&states->entries[p], (uint32_t) PAGE_EMPTY << PAGE_STATE_SHIFT, __ATOMIC_RELEASE);
+    }
+
+    sidecar_sync(&states->entries[page], count * sizeof(uint32_t));
+}
@@ -0,0 +1,73 @@
+#ifndef _PAGE_STATE_H_
+#define _PAGE_STATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sidecar.h"
+
+/*
+* Directory of cache pages: what is known about each page of a cache file,
+* kept in sidecar file `primes.dat.N.pages`. Entry of a page packs its state
+* into the top two bits and the amount of its primes (valid once complete) into the rest,
+* so ranges are counted and complete pages skipped without scanning their cells.
+* Entries of complete pages change only when their segment is frozen, then they are cleared.
+*/
+typedef enum page_state
+{
+    PAGE_EMPTY,     /* no cell defined by a fill, point lookups may have stored some */
+    PAGE_PARTIAL,   /* some cells defined by a fill */
+    PAGE_COMPLETE   /* every cell defined, amount of primes is known */
+}
+page_state_t;
+
+#define PAGE_STATE_SHIFT 30
+#define PAGE_PRIMES_MASK ((1u << PAGE_STATE_SHIFT) - 1)
+
+typedef struct page_states
+{
+    sidecar_t sidecar;    /* header unit is the page size */
+    uint32_t  *entries;
+}
+page_states_t;
+
+/*
+* Maps (and when `writable` creates) directory `filename` for `pages` of `page_size`.
+* Returns false if a reader opens a file which does not exist yet.
+*/
+bool page_states_open(page_states_t *states, const char *filename,
+    size_t page_size, size_t pages, bool writable);
+void page_states_close(page_states_t *states);
+
+/*
+* Records `page` as complete holding `primes`, its cells have to be stored before.
+*/
+void page_states_complete(page_states_t *states, size_t page, uint32_t primes);
+
+/*
+* Records that some cells of an empty `page` were defined.
+*/
+void page_states_touch(page_states_t *states, size_t page);
+
+/*
+* Forgets `count` pages from `page` on, e.g. before they are moved to the cold tier.
+* Entries are written to the file before return, so they never outlive the cells.
+*/
+void page_states_clear(page_states_t *states, size_t page, size_t count);
+
+static inline page_state_t page_states_get(const page_states_t *states, size_t page)
+{
+    return __atomic_load_n(&states->entries[page], __ATOMIC_ACQUIRE) >> PAGE_STATE_SHIFT;
+}
+
+/*
+* Amount of primes of a complete `page`.
+*/
+static inline uint32_t page_states_primes(const page_states_t *states, size_t page)
+{
+    return __atomic_load_n(&states->entries[page], __ATOMIC_ACQUIRE) & PAGE_PRIMES_MASK;
+}
+
+
+#endif/*_PAGE_STATE_H_*/
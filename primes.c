@@ -1,8 +1,21 @@
+#define _GNU_SOURCE
 #include "primes.h"
+#include "sieve.h"
+#include "small_primes.h"
+#include "hash_store.h"
+#include "montgomery.h"
+#include "numa.h"
+#include "stats.h"
+#include "segment_state.h"
+#include "cold_store.h"
+#include "mem_budget.h"
+#include "page_state.h"
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <stdlib.h>
 #include <math.h>
@@ -10,12 +23,233 @@
 #include <ctype.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #define FILENAME_PREFIX "primes.dat"
+#define PROOTS_FILENAME "primes.proots"
+#define SPARSE_FILENAME "primes.sparse"
+#define DENSITY_FILENAME "primes.sparse.density"
 #define MAX_FILENAME_SIZE 19
+#define STATE_FILENAME_SUFFIX ".state"
+#define PAGES_FILENAME_SUFFIX ".pages"
+#define MAX_STATE_FILENAME_SIZE 32
 #define MAX_HEADER_NAME_SIZE 32
 #define FILE_CAPACITY (MAX_FILE_SIZE)
+#define MAX_CACHE_FILES (SIZE_MAX / 8 / FILE_CAPACITY + 1)
+#define FILE_TABLE_CHUNK 1024
 #define MAX_CONTENTS_LINE_SIZE 64
+#define FILTER_BATCH_SIZE 64
+#define PMPR_WINDOW_SIZE 16384
+#define PROOT_WALK_BLOCK 32768
+
+/*
+* Parts of a range counted without the page directory are collected at most that wide.
+*/
+#define COUNT_CHUNK_NUMBERS (1ul << 28)
+
+/*
+* Pattern searches scan prime masks of the cache by chunks of that many words (32 odd numbers each).
+*/
+#define PATTERN_CHUNK_WORDS (1ul << 18)
+
+/*
+* Parallel range engine splits cache into segments of SEGMENT_PAGES pages,
+* each is sieved and stored by one worker, ROUND_SEGMENTS segments are merged at once.
+*/
+#define SEGMENT_PAGES 16
+#define ROUND_SEGMENTS 1024
+
+/*
+* Ranges spanning at least that many numbers are sieved by the parallel engine,
+* smaller ones are tested number by number.
+*/
+#define PARALLEL_RANGE_THRESHOLD (1ul << 20)
+
+/*
+* Undefined cells met by prime navigation are sieved in windows of at least
+* NAVIGATION_GAPS expected prime gaps (ln n), so a window usually holds a prime.
+*/
+#define NAVIGATION_GAPS 4
+
+/*
+* In sparse mode a page of the cache is mapped only once SPARSE_PROMOTE_RESULTS
+* results within it were calculated, until then they are kept in the sparse store.
+* Density of a promoted page is set to PROMOTED_PAGE.
+*/
+#define SPARSE_PROMOTE_RESULTS 64
+#define PROMOTED_PAGE UINT32_MAX
+
+/*
+* Read-ahead: once READ_AHEAD_CONFIDENCE consecutive segment switches of the cache
+* had the same stride (at most READ_AHEAD_MAX_STRIDE segments), READ_AHEAD_DEPTH
+* segments ahead are prefetched and sieved by a background worker.
+*/
+#define READ_AHEAD_CONFIDENCE 2
+#define READ_AHEAD_MAX_STRIDE 1024
+#define READ_AHEAD_DEPTH 4
+#define READ_AHEAD_QUEUE 64
+
+/*
+* Largest prime used for sieving segment by segment, survivors of incomplete sieve are verified
+* by `is_prime`. The range engine sieves beyond it by larger primes kept in buckets (see sieve.h),
+* up to the square root of 2^64.
+*/
+#define MAX_SIEVING_PRIME (1ul << 26)
+#define MAX_BUCKET_PRIME UINT32_MAX
+
+/*
+* All primes up to `limit`, used for sieving cache regions,
+* and primes of (MAX_SIEVING_PRIME, large_limit] for the bucket sieve.
+*/
+typedef struct sieving_primes
+{
+    size_t    *primes;
+    size_t    count;
+    size_t    limit;
+    uint32_t  *large;
+    size_t    large_count;
+    size_t    large_limit;
+}
+sieving_primes_t;
+
+/*
+* Contiguous run of segments of a round, claimed one by one by workers of a single node.
+*/
+typedef struct range_partition
+{
+    size_t    next;         /* next unclaimed segment, atomic */
+    size_t    end;          /* one past the last segment of the run */
+    size_t    claim;        /* segments claimed at once */
+    const numa_node_t *node; /* NULL when placement is not managed */
+}
+range_partition_t;
+
+/*
+* Round of the parallel range engine,
+* primes of each segment are collected into its own vector.
+*/
+typedef struct range_job
+{
+    size_t    begin;
+    size_t    end;
+    size_t    first_segment;
+    size_t    segments;
+    dynarr_t  **results;    /* primes of each segment */
+    const sieving_primes_t *sieving;    /* read locked for the job */
+    bool      buckets;      /* large sieving primes are required */
+    size_t    partitions_count;
+    range_partition_t partitions[MAX_NUMA_NODES];
+}
+range_job_t;
+
+/*
+* State of a single worker of the parallel range engine.
+*/
+typedef struct range_worker
+{
+    range_job_t       *job;
+    range_partition_t *partition;
+    int       fd;
+    size_t    file_idx;
+    uint64_t  *composite;   /* sieve scratch, bit per odd number of a segment */
+}
+range_worker_t;
+
+/*
+* Work done by range workers of a single NUMA node.
+*/
+typedef struct numa_node_stats
+{
+    size_t    segments;
+    size_t    numbers;
+    size_t    nanoseconds;
+}
+numa_node_stats_t;
+
+/*
+* Read-only view of a single cache file for `cache_reader_t`.
+*/
+typedef struct reader_file
+{
+    int       fd;         /* -1 until the file exists */
+    const char *data;     /* `mapped` bytes from the start of the file */
+    size_t    mapped;
+    segment_states_t states;
+    bool      has_states; /* writer initialized the state file */
+}
+reader_file_t;
+
+struct cache_reader
+{
+    size_t    segment_bytes;
+    size_t    files_count;
+    reader_file_t *files;
+};
+
+struct prime_view
+{
+    size_t    begin;
+    size_t    end;
+    size_t    first_byte;   /* of the first page of the view */
+    size_t    pages;
+    size_t    *ranks;       /* odd primes of the view pages before each page, pages + 1 */
+    size_t    skipped;      /* odd primes of the first page below `begin` */
+    size_t    spans_count;  /* one per cache file */
+    prime_span_t *spans;
+    size_t    *map_sizes;
+};
+
+/*
+* Access pattern tracker and the background worker preparing segments ahead of it.
+* Pattern fields and the queue are guarded by `lock`, range jobs of several threads report to it.
+*/
+typedef struct read_ahead
+{
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    bool            running;
+    size_t          queue[READ_AHEAD_QUEUE]; /* ring of segments to prepare */
+    size_t          head;
+    size_t          tail;
+
+    size_t          last_segment;
+    long            stride;     /* in segments */
+    size_t          confidence; /* repetitions of the stride */
+    size_t          scheduled;  /* furthest segment queued in stride direction */
+
+    range_worker_t  worker;     /* mapping state of the background worker */
+    sieving_primes_t sieving;   /* of the background worker */
+}
+read_ahead_t;
+
+/*
+* Sidecar objects of cache files (segment states, page directories, cold tiers) indexed by file.
+* Entries are allocated in chunks which never move, so an entry once published
+* is found without a lock.
+*/
+typedef struct file_table
+{
+    void      **chunks[MAX_CACHE_FILES / FILE_TABLE_CHUNK];
+}
+file_table_t;
+
+/*
+* Opens sidecar object of the cache file `file_idx`, NULL if it does not exist and `create` is not set.
+*/
+typedef void *(*open_file_entry_t)(size_t file_idx, bool create);
+typedef void (*close_file_entry_t)(void *entry);
+
+struct proot_ctx
+{
+    factorization_t factors;        /* factors of (prime - 1) */
+    uint64_t        exponents[MAX_UNIQUE_FACTORS]; /* (prime - 1) / factor */
+    uint64_t        powers[MAX_UNIQUE_FACTORS];    /* candidate ^ exponent */
+    montgomery_t    mont;           /* arithmetic modulo current prime */
+    uint64_t        coprime[PROOT_WALK_BLOCK / 64]; /* odd exponents coprime to (prime - 1) */
+    uint64_t        *roots;         /* bitmap of primitive roots, bit per residue */
+    size_t          roots_capacity; /* in bits */
+};
 
 static void open_cache(cache_t *cache);
 static void change_file(cache_t *cache, size_t file_idx);
@@ -24,25 +258,320 @@ static void close_cache(cache_t *cache);
 static cache_value_t check_prime(cache_t *cache, size_t number);
 static void set_prime(cache_t *cache, size_t prime, cache_value_t value);
 
-static void find_prime_factors(size_t prime, dynarr_t **out);
-static void check_factor(size_t factor, size_t *number, dynarr_t **out);
+/*
+* Answers odd `number` from the `cache`, calculating and storing it on a miss.
+*/
+static bool lookup_cache(cache_t *cache, size_t number);
+
+/*
+* Defines every cell of the page or the segment holding odd `number` according to `s_miss_policy`,
+* returns false if the policy is to calculate single numbers or sieving primes do not reach
+* square root of the block.
+*/
+static bool fill_miss_block(cache_t *cache, size_t number);
+
+/*
+* Answers odd `number` from the sparse store into `out`, calculating and storing it on a miss.
+* Returns false if its page is dense, so the number has to be looked up in the `cache`.
+*/
+static bool lookup_sparse(cache_t *cache, size_t number, bool *out);
+
+/*
+* Whether the segment starting at `first_byte` is published as complete,
+* only states already opened by this process are consulted.
+*/
+static bool is_segment_published(size_t first_byte);
+
+/*
+* Opens (creating if necessary) cache file with index `file_idx`.
+*/
+static int open_cache_file(size_t file_idx);
+
+/*
+* Grows cache file `file_idx` opened as `fd` up to `size` bytes, never shrinks it.
+* Safe to call from workers, sizes are tracked in memory so the file is not queried each time.
+*/
+static void extend_cache_file(size_t file_idx, int fd, size_t size);
+
+/*
+* Allocates blocks of the cache for `length` bytes from `first_byte` on, ahead of a dense fill,
+* so they are laid out contiguously instead of in order of the scattered page writes.
+*/
+static void preallocate_cache_range(size_t first_byte, size_t length);
+
+/*
+* Logical size of the cache file `file_idx`, queried on first use. Called under `s_extend_lock`.
+*/
+static size_t *get_file_size(size_t file_idx, int fd);
+
+/*
+* Parallel range engine for odd `begin`, above the L1 bitset.
+* Collects primes into `out`, cells are only stored when it is NULL.
+*/
+static void sieve_range(size_t begin, size_t end, size_t threads, dynarr_t **out);
+static void *range_worker(void *param);
+
+/*
+* Splits segments of the `job` into partitions, one per NUMA node in NUMA mode,
+* returns amount of workers for each partition in `workers`.
+*/
+static void partition_range_job(range_job_t *job, size_t threads, size_t *workers);
+
+/*
+* Buckets of the run of `job` segments [first, last), resumed from those kept by `keep_buckets`
+* when the run starts where they stopped. The last run of a round keeps primes whose multiples
+* are past it, so the next round or range may resume it; other runs drop them.
+*/
+static void take_buckets(const range_job_t *job, size_t first, size_t last, bucket_sieve_t *buckets);
+static void keep_buckets(const range_job_t *job, size_t last, bucket_sieve_t *buckets);
+
+/*
+* Maps `length` bytes of the cache starting at `first_byte` for the `worker`.
+*/
+static char *map_cache_region(range_worker_t *worker, size_t first_byte, size_t length);
+
+/*
+* Maps `length` bytes at `file_offset` of the cache file `file_idx` opened as `fd`
+* out of the memory budget pool, which knows regions in use even when the budget is not set.
+* Region has to be released by `unmap_cache_region`.
+*/
+static char *map_cache_file_region(int fd, size_t file_idx, size_t file_offset, size_t length);
+static void unmap_cache_region(char *region, size_t length);
+
+/*
+* Defines every cell of the mapped cache region that starts at `first_byte`.
+*/
+static void fill_cache_region(char *region, size_t first_byte, size_t length,
+    const sieving_primes_t *sieving, bucket_sieve_t *buckets, uint64_t *composite);
+static bool is_region_complete(const char *region, size_t length);
+
+/*
+* Appends primes of the cache region which are within [begin, end] to `out`.
+*/
+static void collect_region_primes(const char *region, size_t first_byte, size_t length,
+    size_t begin, size_t end, dynarr_t **out);
+
+/*
+* Entry of the cache file `file_idx` in the `table`, opened by `open_entry` under `s_states_lock`
+* on first use. NULL if it was not opened, which is remembered until `create` is set.
+*/
+static void *get_file_entry(file_table_t *table, size_t file_idx, bool create, open_file_entry_t open_entry);
+
+/*
+* Entry already opened by `get_file_entry`, without locking and opening. NULL if there is none.
+*/
+static void *find_file_entry(const file_table_t *table, size_t file_idx);
+static void close_file_table(file_table_t *table, close_file_entry_t close_entry);
+
+/*
+* Completion states of segments of the cache file `file_idx`, opened on first use.
+*/
+static segment_states_t *get_segment_states(size_t file_idx);
+static void *open_segment_states(size_t file_idx, bool create);
+static void close_segment_states(void *entry);
+static void format_state_filename(size_t file_idx, const char *suffix, char *out);
+
+/*
+* Page directory of the cache file `file_idx`, opened on first use.
+*/
+static page_states_t *get_page_states(size_t file_idx);
+static void *open_page_states(size_t file_idx, bool create);
+static void close_page_states(void *entry);
+
+/*
+* Records pages of the complete cache region starting at page aligned `first_byte`
+* in the page directory along with amounts of their primes.
+*/
+static void record_complete_pages(const char *region, size_t first_byte, size_t length);
+
+/*
+* Whether every page of the cache region starting at `first_byte` is recorded as complete.
+*/
+static bool is_region_recorded(size_t first_byte, size_t length);
+
+/*
+* Records that a fill defined some cells of the page holding `byte_offset` of the cache.
+* Point stores do not, so lookups never open the page directory.
+*/
+static void touch_cache_page(size_t byte_offset);
+
+/*
+* Amount of primes within [low, high] collected by `get_primes_range`.
+*/
+static size_t count_collected_primes(size_t low, size_t high);
+
+/*
+* Cold tier of the cache file `file_idx`, NULL if it does not exist and `create` is not set.
+*/
+static cold_store_t *get_cold_store(size_t file_idx, bool create);
+static void *open_cold_store(size_t file_idx, bool create);
+static void close_cold_store(void *entry);
+
+/*
+* Restores frozen segment of the mapped `region` that starts at `first_byte`,
+* returns false if the segment is not in the cold tier.
+*/
+static bool thaw_cache_region(char *region, size_t first_byte);
+
+/*
+* Restores frozen segment which holds `file_offset` of the `cache` file, before its page is mapped.
+*/
+static void thaw_cache_page(cache_t *cache, size_t file_offset);
+
+/*
+* Read-only view of the cache file `file_idx`,
+* NULL while the file or its state is not created by the writer.
+*/
+static reader_file_t *get_reader_file(cache_reader_t *reader, size_t file_idx);
+
+/*
+* Makes sure the reader `file` is mapped up to `limit` bytes. Mapping follows the size
+* of the file, grown by the writer, returns false if the file is still shorter.
+*/
+static bool map_reader_file(reader_file_t *file, size_t limit);
+
+/*
+* Cell word of the `view` holding odd `number` of the view pages.
+*/
+static const uint64_t *get_view_word(const prime_view_t *view, size_t number);
+
+/*
+* Odd primes of the `view` pages from the first one up to odd `number` inclusive.
+*/
+static size_t count_view_primes(const prime_view_t *view, size_t number);
+
+/*
+* Stores a mask of primes of the `view` for each of `count` words from `first_word` on,
+* word `w` holds odd numbers of [64 * w, 64 * w + 63], bit `2 * i` of its mask is set
+* when its cell `i` is a prime. Words outside the view are zero.
+*/
+static void load_prime_masks(const prime_view_t *view, size_t first_word, size_t count, uint64_t *masks);
+
+/*
+* Prime navigation over the L1 bitset, odd `number` has to be below its limit.
+* Return zero when there is no prime in the bitset in that direction.
+*/
+static size_t next_l1_prime(const l1_cache_t *l1, size_t number);
+static size_t prev_l1_prime(const l1_cache_t *l1, size_t number);
+
+/*
+* Prime navigation over the cache from odd `number` on, backward scan stops below `floor`.
+* Return zero if no prime is found.
+*/
+static size_t next_cached_prime(cache_t *cache, size_t number);
+static size_t prev_cached_prime(cache_t *cache, size_t number, size_t floor);
+
+/*
+* Defines cells of the window of the opened cache page around page word `word`,
+* `forward` selects whether the window follows or precedes it.
+*/
+static void fill_navigation_window(cache_t *cache, size_t word, bool forward);
+
+/*
+* Feeds the access pattern tracker with the segment being accessed by the caller,
+* queues segments ahead of a detected stream.
+*/
+static void note_access(size_t segment);
+static void *read_ahead_worker(void *param);
+
+/*
+* Prefetches `segment` of the cache and defines its cells, unless the sieve would be incomplete.
+*/
+static void prepare_segment(read_ahead_t *ra, size_t segment);
+
+/*
+* Makes sure `sieving` contains all primes up to `limit`, only primes above those
+* already known are sieved, so limits can follow square roots of queries exactly.
+*/
+static void reserve_sieving_primes(sieving_primes_t *sieving, size_t limit);
+static void free_sieving_primes(sieving_primes_t *sieving);
+
+/*
+* Makes sure `sieving` contains large primes up to `limit`, same as `reserve_sieving_primes`.
+*/
+static void reserve_bucket_primes(sieving_primes_t *sieving, size_t limit);
+
+/*
+* Reserves sieving primes up to square root of `high`.
+* Returns false if they can not reach the square root.
+*/
+static bool reserve_sieving_primes_for(sieving_primes_t *sieving, size_t high);
+
+/*
+* Shared sieving primes holding all primes up to `limit` and large ones up to `large_limit`,
+* grown first if needed. They stay read locked until `release_sieving_primes`,
+* so no caller sees them while another one grows them.
+*/
+static const sieving_primes_t *acquire_sieving_primes(size_t limit, size_t large_limit);
+static void release_sieving_primes(void);
+
+/*
+* Acquires shared sieving primes as `reserve_sieving_primes_for` reserves them,
+* NULL if they can not reach the square root of `high`.
+*/
+static const sieving_primes_t *acquire_sieving_primes_for(size_t high);
+
+static void open_l1_cache(l1_cache_t *l1, size_t limit);
+static void close_l1_cache(l1_cache_t *l1);
+static bool check_l1_prime(const l1_cache_t *l1, size_t number);
+
+static void find_prime_factors(size_t prime, factorization_t *out);
+static void check_factor(size_t factor, size_t *number, factorization_t *out);
+
+/*
+* Same as `check_factor`, divisibility tested and divided out by precomputed inverse.
+*/
+static void check_small_factor(const small_prime_t *sp, size_t *number, factorization_t *out);
+
+/*
+* Lowest primitive root of the `prime` given factorization of (prime - 1).
+*/
+static size_t lowest_primitive_root(proot_ctx_t *ctx, size_t prime, const factorization_t *factors);
+
+/*
+* Medium range primitive root of the `prime` given its lowest primitive root
+* and factorization of (prime - 1).
+*/
+static size_t medium_range_proot(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    const factorization_t *factors);
+
+/*
+* Power walk over lowest_root^k for odd k coprime to (prime - 1),
+* one montgomery multiplication by lowest_root^2 per step.
+*/
+static void walk_roots(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    const factorization_t *factors, proot_visit_t visit, void *param);
+
+/*
+* Marks all primitive roots of the odd `prime` in `ctx->roots` bitmap, returns their amount.
+*/
+static size_t collect_primitive_roots(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    const factorization_t *factors);
+static bool mark_root(size_t root, void *param);
+
+/*
+* Returns primitive root of the given `rank` (zero based) in ascending order,
+* out of collected into `ctx->roots`.
+*/
+static size_t select_primitive_root(const proot_ctx_t *ctx, size_t rank);
 
 /*
-* Modular exponentiation algorithm.
-* Allows calculations of modular division for very large numbers
-* that can be only expressed in form of x^y.
+* Makes sure roots bitmap of the `ctx` holds all residues of the `prime`.
 */
-static ssize_t modpow(size_t base, size_t exp, size_t mod);
+static void reserve_roots(proot_ctx_t *ctx, size_t prime);
 
 /*
-* Euclidean recursive greatest commont divider algorithm.
+* Lookup/store of primitive roots in the persistent roots store.
+* Primes without primitive roots are not memoized.
 */
-static size_t gcd(size_t a, size_t b);
+static bool find_memoized_proots(size_t prime, proot_entry_t *out);
+static void memoize_proots(size_t prime, const proot_entry_t *entry);
 
 /*
-* Used for binary sorted insertion algorithm.
+* Jacobi symbol (a/n) for odd `n`, for prime `n` it equals to Legendre symbol:
+* 1 for quadratic residues, -1 for non-residues and 0 when `n` divides `a`.
 */
-static ssize_t cmp_asc(const void *value, const void *element, void *param);
+static int jacobi(size_t a, size_t n);
 
 
 static void generate_include_guard(const char *filename, char *out);
@@ -58,427 +587,2967 @@ static size_t s_page_size;
 */
 static cache_t s_cache = {};
 
+/*
+* global in-RAM bitset of small primes, in front of the `s_cache`.
+*/
+static l1_cache_t s_l1_cache = {};
+
+/*
+* global persistent store of primitive roots: prime -> proot_entry_t.
+*/
+static hash_store_t s_proot_store = {};
+
+/*
+* Sparse storage of isolated results, see `set_sparse_mode`:
+* odd number -> cache_value_t, (page + 1) -> amount of its stored results or PROMOTED_PAGE.
+*/
+static bool s_sparse_mode;
+static hash_store_t s_sparse_store = {};
+static hash_store_t s_density_store = {};
+
+/*
+* Primes used for sieving by the range engine and the calling thread.
+* Grown under the write lock only, see `acquire_sieving_primes`.
+*/
+static sieving_primes_t s_sieving;
+static pthread_rwlock_t s_sieving_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*
+* Buckets left by the last run of a range engine round, positioned at `s_buckets_segment`.
+* A run starting there resumes them instead of placing every large prime again.
+*/
+static bucket_sieve_t s_buckets;
+static size_t s_buckets_segment = -1ul;
+static pthread_mutex_t s_buckets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+* NUMA-aware execution of range jobs, see `set_numa_mode`.
+*/
+static bool s_numa_mode;
+static numa_topology_t s_numa_topology;
+static numa_node_stats_t s_numa_stats[MAX_NUMA_NODES];
+
+/*
+* States of cache files published to readers by the range engine, page directories
+* and cold tiers of cache files. Entries are opened under `s_states_lock`,
+* `s_absent_entry` marks files without one.
+*/
+static file_table_t s_segment_states;
+static file_table_t s_page_states;
+static file_table_t s_cold_stores;
+static pthread_mutex_t s_states_lock = PTHREAD_MUTEX_INITIALIZER;
+static char s_absent_entry;
+
+/*
+* Serializes cache file extension between workers.
+*/
+static pthread_mutex_t s_extend_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+* Logical sizes of cache files indexed by file, -1 until queried. Guarded by `s_extend_lock`.
+*/
+static size_t *s_file_sizes;
+static size_t s_file_sizes_count;
+
+/*
+* Sieve scratch of prime navigation and cache misses, bit per odd number of a segment.
+*/
+static uint64_t *s_block_composite;
+
+/*
+* How much of the cache is calculated on a point miss, see `set_miss_policy`.
+*/
+static miss_policy_t s_miss_policy = MISS_POLICY_PAGE;
+
+/*
+* Read-ahead of detected access streams, see `set_read_ahead`.
+*/
+static read_ahead_t s_read_ahead = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER
+};
+
+/*
+* Pool of mapped regions of the cache, see `set_cache_memory_budget`.
+*/
+static mem_budget_t s_mem_budget;
+
 
 bool is_prime(size_t number)
 {
-    if (number == 1) return false;
+    if (number < 2) return false;
+    if (number % 2 == 0) return number == 2;
 
-    for (size_t factor = 2; (factor != number && factor <= 3); ++factor)
+    const small_prime_t *small_primes = get_small_primes();
+    for (size_t i = 0; i < SMALL_PRIMES_COUNT; ++i)
     {
-        if (number % factor == 0)
-        {
+        const small_prime_t *sp = &small_primes[i];
+        if (sp->prime * sp->prime > number) return true;
+        if (number * sp->inverse <= sp->limit) return number == sp->prime;
+    }
+
+    const uint8_t *increments = get_wheel_increments();
+    size_t root = isqrt(number);
+
+    for (size_t factor = WHEEL_START, spoke = WHEEL_START_SPOKE;
+         factor <= root;
+         factor += increments[spoke], spoke = (spoke + 1) % WHEEL_SPOKES)
+    {
+        if (number % factor == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void init_cache(void)
+{
+    s_page_size = sysconf(_SC_PAGESIZE);
+
+    s_block_composite = (uint64_t*) malloc(SEGMENT_PAGES * s_page_size * 4 / 8);
+    if (NULL == s_block_composite) exit(EXIT_FAILURE);
+
+    init_small_primes();
+    mem_budget_init(&s_mem_budget);
+    open_l1_cache(&s_l1_cache, L1_CACHE_LIMIT);
+    open_cache(&s_cache);
+    hash_store_open(&s_proot_store, PROOTS_FILENAME, sizeof(proot_entry_t));
+}
+
+
+void fini_cache(void)
+{
+    set_read_ahead(false);
+    hash_store_close(&s_proot_store);
+    if (s_sparse_store.map)
+    {
+        hash_store_close(&s_sparse_store);
+        hash_store_close(&s_density_store);
+        s_sparse_mode = false;
+    }
+    close_file_table(&s_segment_states, close_segment_states);
+    close_file_table(&s_page_states, close_page_states);
+    close_file_table(&s_cold_stores, close_cold_store);
+    close_cache(&s_cache);
+    close_l1_cache(&s_l1_cache);
+    mem_budget_close(&s_mem_budget);
+
+    free(s_file_sizes);
+    s_file_sizes = NULL;
+    s_file_sizes_count = 0;
+
+    free(s_block_composite);
+    s_block_composite = NULL;
+
+    if (s_buckets.buckets) bucket_sieve_free(&s_buckets);
+    s_buckets_segment = -1ul;
+
+    free_sieving_primes(&s_sieving);
+}
+
+
+bool is_prime_cached(size_t number)
+{
+    stats_add(STATS_LOOKUPS, 1);
+
+    if (number == 2) return true;
+    if (number % 2 == 0) return false;
+    if (number < s_l1_cache.limit)
+    {
+        stats_add(STATS_L1_HITS, 1);
+        return check_l1_prime(&s_l1_cache, number);
+    }
+
+    /* most composites have a small factor, no need to map cache page for them */
+    cache_value_t filtered = small_primes_filter(number);
+    if (UNDEFINED != filtered)
+    {
+        stats_add(STATS_FILTER_HITS, 1);
+        return PRIME == filtered;
+    }
+
+    return lookup_cache(&s_cache, number);
+}
+
+
+void are_primes_cached(const size_t *numbers, size_t count, bool *out)
+{
+    cache_value_t filtered[FILTER_BATCH_SIZE];
+    size_t filter_hits = 0;
+
+    for (size_t i = 0; i < count; i += FILTER_BATCH_SIZE)
+    {
+        size_t batch = count - i < FILTER_BATCH_SIZE ? count - i : FILTER_BATCH_SIZE;
+        small_primes_filter_batch(&numbers[i], batch, filtered);
+
+        for (size_t j = 0; j < batch; ++j)
+        {
+            size_t number = numbers[i + j];
+            if (number % 2 == 0 || number < s_l1_cache.limit)
+            {
+                out[i + j] = is_prime_cached(number);
+            }
+            else if (UNDEFINED == filtered[j])
+            {
+                stats_add(STATS_LOOKUPS, 1);
+                out[i + j] = lookup_cache(&s_cache, number);
+            }
+            else
+            {
+                filter_hits++;
+                out[i + j] = PRIME == filtered[j];
+            }
+        }
+    }
+
+    stats_add(STATS_LOOKUPS, filter_hits);
+    stats_add(STATS_FILTER_HITS, filter_hits);
+}
+
+
+dynarr_t *create_primes_array(void)
+{
+    dynarr_t *array = dynarr_create(.element_size = sizeof(size_t));
+    return array;
+}
+
+
+void get_primes_range(size_t begin, size_t end, dynarr_t **out)
+{
+    // dynarr_clear(*out);
+
+    /* even numbers and numbers covered by the bitset are answered directly */
+    for (; begin <= end && (begin <= 2 || begin < s_l1_cache.limit); ++begin)
+    {
+        if (is_prime_cached(begin))
+        {
+            dynarr_append(out, &begin);
+        }
+    }
+
+    if (begin % 2 == 0) ++begin;
+    if (begin > end) return;
+
+    if (end - begin >= PARALLEL_RANGE_THRESHOLD)
+    {
+        sieve_range(begin, end, 0, out);
+        return;
+    }
+
+    /*
+    * Short windows above the square of sieving primes are sieved segment by segment
+    * by a single worker, which resumes buckets left by the previous window.
+    */
+    if (isqrt(end) > MAX_SIEVING_PRIME)
+    {
+        sieve_range(begin, end, 1, out);
+        return;
+    }
+
+    size_t odds = (end - begin) / 2 + 1;
+    size_t numbers[FILTER_BATCH_SIZE];
+    bool primes[FILTER_BATCH_SIZE];
+
+    for (size_t i = 0; i < odds; i += FILTER_BATCH_SIZE)
+    {
+        size_t batch = odds - i < FILTER_BATCH_SIZE ? odds - i : FILTER_BATCH_SIZE;
+        for (size_t j = 0; j < batch; ++j)
+        {
+            numbers[j] = begin + 2 * (i + j);
+        }
+
+        are_primes_cached(numbers, batch, primes);
+
+        for (size_t j = 0; j < batch; ++j)
+        {
+            if (primes[j])
+            {
+                dynarr_append(out, &numbers[j]);
+            }
+        }
+    }
+}
+
+
+size_t count_primes_range(size_t begin, size_t end)
+{
+    size_t page_numbers = s_page_size * 8;
+    size_t count = 0;
+    size_t pending = begin; /* first number not counted yet */
+    bool counted = false;   /* whole range is */
+
+    /* pages within the range above the bitset */
+    size_t first = begin > s_l1_cache.limit ? begin : s_l1_cache.limit;
+    size_t first_page = (first - 1) / page_numbers + 1;
+    size_t last_page = end < page_numbers - 1 ? 0 : (end - (page_numbers - 1)) / page_numbers;
+
+    page_states_t *states = NULL;
+    size_t states_file = -1ul;
+
+    for (size_t page = first_page; page <= last_page && first <= end; ++page)
+    {
+        size_t first_byte = page * s_page_size;
+        if (first_byte / FILE_CAPACITY != states_file)
+        {
+            states_file = first_byte / FILE_CAPACITY;
+            states = get_page_states(states_file);
+        }
+
+        size_t in_file = first_byte % FILE_CAPACITY / s_page_size;
+        if (PAGE_COMPLETE != page_states_get(states, in_file)) continue;
+
+        size_t low = page * page_numbers;
+        if (pending < low) count += count_collected_primes(pending, low - 1);
+        count += page_states_primes(states, in_file);
+
+        counted = end - low == page_numbers - 1;
+        pending = low + page_numbers;
+    }
+
+    if (!counted && pending <= end) count += count_collected_primes(pending, end);
+    return count;
+}
+
+
+void get_primes_range_parallel(size_t begin, size_t end, size_t threads, dynarr_t **out)
+{
+    for (; begin <= end && (begin <= 2 || begin < s_l1_cache.limit); ++begin)
+    {
+        if (is_prime_cached(begin))
+        {
+            dynarr_append(out, &begin);
+        }
+    }
+
+    if (begin % 2 == 0) ++begin;
+    if (begin > end) return;
+
+    sieve_range(begin, end, threads, out);
+}
+
+
+void set_read_ahead(bool enabled)
+{
+    read_ahead_t *ra = &s_read_ahead;
+    if (enabled == ra->running) return;
+
+    if (enabled)
+    {
+        ra->head = ra->tail = 0;
+        ra->stride = 0;
+        ra->confidence = 0;
+        ra->worker = (range_worker_t){ .fd = -1, .file_idx = -1ul };
+        ra->worker.composite = (uint64_t*) malloc(SEGMENT_PAGES * s_page_size * 4 / 8);
+        if (NULL == ra->worker.composite) exit(EXIT_FAILURE);
+
+        ra->running = true;
+        if (0 != pthread_create(&ra->thread, NULL, read_ahead_worker, ra)) exit(EXIT_FAILURE);
+        return;
+    }
+
+    pthread_mutex_lock(&ra->lock);
+    ra->running = false;
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->lock);
+
+    pthread_join(ra->thread, NULL);
+
+    if (-1 != ra->worker.fd) close(ra->worker.fd);
+    free(ra->worker.composite);
+    free_sieving_primes(&ra->sieving);
+}
+
+
+void set_cache_memory_budget(size_t bytes)
+{
+    mem_budget_set_limit(&s_mem_budget, bytes);
+}
+
+
+void get_cache_memory_usage(mem_usage_t *out)
+{
+    mem_budget_usage(&s_mem_budget, out);
+}
+
+
+void set_sparse_mode(bool enabled)
+{
+    if (enabled && NULL == s_sparse_store.map)
+    {
+        hash_store_open(&s_sparse_store, SPARSE_FILENAME, sizeof(uint8_t));
+        hash_store_open(&s_density_store, DENSITY_FILENAME, sizeof(uint32_t));
+    }
+    s_sparse_mode = enabled;
+}
+
+
+void set_miss_policy(miss_policy_t policy)
+{
+    s_miss_policy = policy;
+}
+
+
+size_t next_prime(size_t number)
+{
+    if (number < 2) return 2;
+    if (number >= LARGEST_PRIME) return 0;
+
+    size_t candidate = (number + 1) | 1;
+
+    if (candidate < s_l1_cache.limit)
+    {
+        size_t prime = next_l1_prime(&s_l1_cache, candidate);
+        if (prime) return prime;
+
+        candidate = s_l1_cache.limit | 1;
+    }
+
+    return next_cached_prime(&s_cache, candidate);
+}
+
+
+size_t prev_prime(size_t number)
+{
+    if (number <= 2) return 0;
+    if (number == 3) return 2;
+
+    size_t candidate = (number - 2) | 1;
+
+    if (candidate >= s_l1_cache.limit)
+    {
+        size_t prime = prev_cached_prime(&s_cache, candidate, s_l1_cache.limit);
+        if (prime) return prime;
+
+        if (s_l1_cache.limit <= 3) return 2;
+
+        candidate = (s_l1_cache.limit - 2) | 1;
+    }
+
+    size_t prime = prev_l1_prime(&s_l1_cache, candidate);
+    return prime ? prime : 2;
+}
+
+
+size_t next_prime_k(size_t number, size_t k)
+{
+    /* zero is a valid start, afterwards it means there is no further prime */
+    for (; k; --k)
+    {
+        number = next_prime(number);
+        if (0 == number) break;
+    }
+    return number;
+}
+
+
+size_t prev_prime_k(size_t number, size_t k)
+{
+    /* zero is a valid start, afterwards it means there is no further prime */
+    for (; k; --k)
+    {
+        number = prev_prime(number);
+        if (0 == number) break;
+    }
+    return number;
+}
+
+
+void set_numa_mode(bool enabled)
+{
+    s_numa_mode = enabled;
+    if (!enabled) return;
+
+    numa_load_topology(&s_numa_topology);
+    memset(s_numa_stats, 0, sizeof(s_numa_stats));
+}
+
+
+void print_numa_report(FILE *file)
+{
+    if (!s_numa_mode) return;
+
+    for (size_t n = 0; n < s_numa_topology.count; ++n)
+    {
+        const numa_node_stats_t *stats = &s_numa_stats[n];
+        double seconds = stats->nanoseconds / 1e9;
+
+        fprintf(file, "node %d: %zu cpus, %zu segments, %zu numbers, %.3f worker-seconds, %.0f numbers/s\n",
+            s_numa_topology.nodes[n].id,
+            s_numa_topology.nodes[n].cpu_count,
+            stats->segments,
+            stats->numbers,
+            seconds,
+            seconds > 0 ? stats->numbers / seconds : 0.0);
+    }
+}
+
+
+void print_cache_stats(FILE *file)
+{
+    stats_dump(file);
+}
+
+
+void reset_cache_stats(void)
+{
+    stats_reset();
+}
+
+
+void set_stats_timing(bool enabled)
+{
+    stats_set_timing(enabled);
+}
+
+
+size_t freeze_cache_range(size_t begin, size_t end)
+{
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t first_segment = begin / 8 / segment_bytes;
+    size_t last_segment = end / 8 / segment_bytes;
+    size_t frozen = 0;
+
+    range_worker_t worker = { .fd = -1, .file_idx = -1ul };
+
+    for (size_t segment = first_segment; segment <= last_segment; ++segment)
+    {
+        size_t first_byte = segment * segment_bytes;
+        size_t file_idx = first_byte / FILE_CAPACITY;
+        size_t file_offset = first_byte % FILE_CAPACITY;
+        size_t in_file = file_offset / segment_bytes;
+
+        cold_store_t *store = get_cold_store(file_idx, true);
+        if (cold_store_is_frozen(store, in_file)) continue;
+
+        char *region = map_cache_region(&worker, first_byte, segment_bytes);
+
+        /* segment in use by another worker stays, regions are not acquired until it is punched */
+        pthread_mutex_lock(&s_mem_budget.lock);
+        if (is_region_complete(region, segment_bytes)
+            && !mem_budget_is_pinned(&s_mem_budget, file_idx, file_offset, segment_bytes, region))
+        {
+            /* readers, the page directory and the point lookup page must not see the hole */
+            segment_states_clear(get_segment_states(file_idx), in_file);
+            page_states_clear(get_page_states(file_idx), file_offset / s_page_size, SEGMENT_PAGES);
+            if (s_cache.page_offset - first_byte < segment_bytes)
+            {
+                munmap(s_cache.page, s_page_size);
+                s_cache.page = NULL;
+                s_cache.page_offset = -1ul;
+            }
+
+            if (cold_store_freeze(store, in_file, region, worker.fd, file_offset))
+            {
+                stats_add(STATS_SEGMENTS_FROZEN, 1);
+                ++frozen;
+            }
+        }
+        pthread_mutex_unlock(&s_mem_budget.lock);
+
+        unmap_cache_region(region, segment_bytes);
+        if (segment == last_segment) break;
+    }
+
+    if (-1 != worker.fd) close(worker.fd);
+    return frozen;
+}
+
+
+cache_reader_t *cache_reader_open(void)
+{
+    cache_reader_t *reader = (cache_reader_t*) calloc(1, sizeof(cache_reader_t));
+    if (NULL == reader) exit(EXIT_FAILURE);
+
+    reader->segment_bytes = SEGMENT_PAGES * sysconf(_SC_PAGESIZE);
+    return reader;
+}
+
+
+void cache_reader_close(cache_reader_t *reader)
+{
+    for (size_t i = 0; i < reader->files_count; ++i)
+    {
+        reader_file_t *file = &reader->files[i];
+        if (file->has_states) segment_states_close(&file->states);
+        if (-1 == file->fd) continue;
+
+        if (file->mapped) munmap((void*) file->data, file->mapped);
+        close(file->fd);
+    }
+
+    free(reader->files);
+    free(reader);
+}
+
+
+size_t cache_reader_get_primes_range(cache_reader_t *reader, size_t begin, size_t end, dynarr_t **out)
+{
+    size_t segment_bytes = reader->segment_bytes;
+    size_t number = begin;
+
+    while (number <= end)
+    {
+        size_t first_byte = number / 8 / segment_bytes * segment_bytes;
+        size_t file_idx = first_byte / FILE_CAPACITY;
+        size_t segment = first_byte % FILE_CAPACITY / segment_bytes;
+
+        reader_file_t *file = get_reader_file(reader, file_idx);
+        if (NULL == file || !segment_states_is_complete(&file->states, segment)) return number;
+        if (!map_reader_file(file, first_byte % FILE_CAPACITY + segment_bytes)) return number;
+
+        if (number <= 2 && end >= 2)
+        {
+            size_t two = 2;
+            dynarr_append(out, &two);
+        }
+
+        const char *region = file->data + first_byte % FILE_CAPACITY;
+        collect_region_primes(region, first_byte, segment_bytes, number, end, out);
+
+        size_t next = (first_byte + segment_bytes) * 8;
+        if (next <= number) break; /* end of numbers */
+        number = next;
+    }
+
+    return end + 1;
+}
+
+
+bool cache_reader_check_prime(cache_reader_t *reader, size_t number, bool *out)
+{
+    if (number % 2 == 0)
+    {
+        *out = number == 2;
+        return true;
+    }
+
+    size_t byte = number / 8;
+    size_t file_idx = byte / FILE_CAPACITY;
+    size_t segment = byte % FILE_CAPACITY / reader->segment_bytes;
+
+    reader_file_t *file = get_reader_file(reader, file_idx);
+    if (NULL == file || !segment_states_is_complete(&file->states, segment)) return false;
+    if (!map_reader_file(file, byte % FILE_CAPACITY + 1)) return false;
+
+    size_t bit = (number / 2 % 4) * 2;
+    *out = PRIME == ((file->data[byte % FILE_CAPACITY] >> bit) & VALUES_TOTAL);
+    return true;
+}
+
+
+prime_view_t *prime_view_open(size_t begin, size_t end)
+{
+    prime_view_t *view = (prime_view_t*) calloc(1, sizeof(prime_view_t));
+    if (NULL == view) exit(EXIT_FAILURE);
+
+    view->begin = begin;
+    view->end = end;
+
+    size_t first_odd = begin | 1;
+    size_t last_odd = end % 2 ? end : end - 1;
+    if (begin > end || 0 == end || first_odd > last_odd) return view;
+
+    /* cells are stored by the range engine, nothing is collected */
+    sieve_range(first_odd, last_odd, 0, NULL);
+
+    view->first_byte = first_odd / 8 / s_page_size * s_page_size;
+    size_t last_byte = last_odd / 8 / s_page_size * s_page_size;
+    view->pages = (last_byte - view->first_byte) / s_page_size + 1;
+
+    size_t first_file = view->first_byte / FILE_CAPACITY;
+    view->spans_count = last_byte / FILE_CAPACITY - first_file + 1;
+    view->spans = (prime_span_t*) calloc(view->spans_count, sizeof(prime_span_t));
+    view->map_sizes = (size_t*) calloc(view->spans_count, sizeof(size_t));
+    view->ranks = (size_t*) malloc((view->pages + 1) * sizeof(size_t));
+    if (!view->spans || !view->map_sizes || !view->ranks) exit(EXIT_FAILURE);
+    view->ranks[0] = 0;
+
+    for (size_t i = 0; i < view->spans_count; ++i)
+    {
+        size_t file_idx = first_file + i;
+        size_t from = i ? file_idx * FILE_CAPACITY : view->first_byte;
+        size_t to = i + 1 < view->spans_count ? (file_idx + 1) * FILE_CAPACITY : last_byte + s_page_size;
+
+        /* pinned in the pool while the view is open, so its segments are not frozen */
+        int fd = open_cache_file(file_idx);
+        char *map = map_cache_file_region(fd, file_idx, from % FILE_CAPACITY, to - from);
+        close(fd);
+
+        view->spans[i] = (prime_span_t){
+            .words = (const uint64_t*) map,
+            .words_count = (to - from) / sizeof(uint64_t),
+            .first_number = from * 8 + 1
+        };
+        view->map_sizes[i] = to - from;
+
+        /* every page is complete now, its amount of primes is in the directory */
+        page_states_t *states = get_page_states(file_idx);
+        size_t first_page = (from - view->first_byte) / s_page_size;
+        size_t file_page = from % FILE_CAPACITY / s_page_size;
+        for (size_t p = 0; p < (to - from) / s_page_size; ++p)
+        {
+            view->ranks[first_page + p + 1] = view->ranks[first_page + p] + page_states_primes(states, file_page + p);
+        }
+    }
+
+    size_t first_number = view->first_byte * 8 + 1;
+    view->skipped = first_odd > first_number ? count_view_primes(view, first_odd - 2) : 0;
+    return view;
+}
+
+
+void prime_view_close(prime_view_t *view)
+{
+    for (size_t i = 0; i < view->spans_count; ++i)
+    {
+        unmap_cache_region((char*) view->spans[i].words, view->map_sizes[i]);
+    }
+
+    free(view->spans);
+    free(view->map_sizes);
+    free(view->ranks);
+    free(view);
+}
+
+
+size_t prime_view_spans(const prime_view_t *view, const prime_span_t **out)
+{
+    *out = view->spans;
+    return view->spans_count;
+}
+
+
+bool prime_view_test(const prime_view_t *view, size_t number)
+{
+    if (number < view->begin || number > view->end) return false;
+    if (number % 2 == 0) return number == 2;
+
+    uint64_t word = *get_view_word(view, number);
+    return PRIME == ((word >> (number / 2 % 32 * 2)) & VALUES_TOTAL);
+}
+
+
+size_t prime_view_rank(const prime_view_t *view, size_t number)
+{
+    if (number < view->begin) return 0;
+    if (number > view->end) number = view->end;
+
+    size_t rank = view->begin <= 2 && number >= 2 ? 1 : 0;
+
+    if (number < (view->begin | 1)) return rank;
+
+    size_t last_odd = number % 2 ? number : number - 1;
+    return rank + count_view_primes(view, last_odd) - view->skipped;
+}
+
+
+size_t prime_view_select(const prime_view_t *view, size_t rank)
+{
+    if (view->begin <= 2 && view->end >= 2)
+    {
+        if (0 == rank) return 2;
+        --rank;
+    }
+    if (0 == view->pages) return 0;
+
+    size_t target = rank + view->skipped;
+    if (target >= view->ranks[view->pages]) return 0;
+
+    /* last page whose preceding primes do not exceed the target */
+    size_t low = 0, high = view->pages;
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (view->ranks[middle] <= target) low = middle;
+        else high = middle;
+    }
+
+    size_t first_number = (view->first_byte + low * s_page_size) * 8 + 1;
+    const uint64_t *words = get_view_word(view, first_number);
+    size_t left = target - view->ranks[low];
+
+    for (size_t i = 0; i < s_page_size / sizeof(uint64_t); ++i)
+    {
+        uint64_t primes = words[i] & ~(words[i] >> 1) & 0x5555555555555555ul;
+        size_t count = __builtin_popcountl(primes);
+        if (left >= count)
+        {
+            left -= count;
+            continue;
+        }
+
+        for (; left; --left) primes &= primes - 1;
+
+        size_t number = first_number + 2 * (i * 32 + __builtin_ctzl(primes) / 2);
+        return number <= view->end ? number : 0;
+    }
+    return 0;
+}
+
+
+size_t prime_view_count(const prime_view_t *view)
+{
+    return prime_view_rank(view, view->end);
+}
+
+
+size_t find_prime_tuples(size_t begin, size_t end, const size_t *offsets, size_t count,
+    prime_match_visit_t visit, void *param)
+{
+    /* pattern starts at its first prime, the rest are odd numbers too */
+    if (0 == count || 0 != offsets[0]) return 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+        if (offsets[i] % 2 || offsets[i] <= offsets[i - 1]) return 0;
+    }
+
+    size_t width = offsets[count - 1];
+    if (begin > end || end - begin < width) return 0;
+
+    size_t last_start = end - width;
+    size_t matches = 0;
+
+    /* 2 is the only even prime, so it matches only by itself */
+    if (1 == count && begin <= 2 && end >= 2)
+    {
+        ++matches;
+        if (!visit(2, 0, param)) return matches;
+    }
+
+    /* words past a starting one its tuple reaches */
+    size_t reach = width / 64 + 2;
+    uint64_t *masks = (uint64_t*) malloc((PATTERN_CHUNK_WORDS + reach) * sizeof(uint64_t));
+    if (NULL == masks) exit(EXIT_FAILURE);
+
+    /* the range is calculated and mapped once, chunks only read its masks */
+    prime_view_t *view = prime_view_open(begin, end);
+
+    bool running = true;
+    for (size_t first = begin / 64; running && first <= last_start / 64; first += PATTERN_CHUNK_WORDS)
+    {
+        size_t words = last_start / 64 - first + 1;
+        if (words > PATTERN_CHUNK_WORDS) words = PATTERN_CHUNK_WORDS;
+
+        load_prime_masks(view, first, words + reach, masks);
+
+        for (size_t w = 0; running && w < words; ++w)
+        {
+            /* shift-AND: a bit survives if primes follow it at every offset */
+            uint64_t found = masks[w];
+            for (size_t i = 1; found && i < count; ++i)
+            {
+                const uint64_t *next = &masks[w + offsets[i] / 64];
+                size_t shift = offsets[i] % 64;
+                found &= shift ? next[0] >> shift | next[1] << (64 - shift) : next[0];
+            }
+
+            for (; running && found; found &= found - 1)
+            {
+                size_t prime = (first + w) * 64 + 1 + __builtin_ctzl(found);
+                if (prime > last_start) break;
+
+                ++matches;
+                running = visit(prime, width, param);
+            }
+        }
+    }
+
+    prime_view_close(view);
+    free(masks);
+    return matches;
+}
+
+
+size_t find_prime_gaps(size_t begin, size_t end, size_t min_gap,
+    prime_match_visit_t visit, void *param)
+{
+    if (begin > end) return 0;
+
+    size_t matches = 0;
+    size_t last = begin <= 2 && end >= 2 ? 2 : 0; /* previous prime, zero before the first one */
+
+    uint64_t *masks = (uint64_t*) malloc(PATTERN_CHUNK_WORDS * sizeof(uint64_t));
+    if (NULL == masks) exit(EXIT_FAILURE);
+
+    prime_view_t *view = prime_view_open(begin, end);
+
+    bool running = true;
+    for (size_t first = begin / 64; running && first <= end / 64; first += PATTERN_CHUNK_WORDS)
+    {
+        size_t words = end / 64 - first + 1;
+        if (words > PATTERN_CHUNK_WORDS) words = PATTERN_CHUNK_WORDS;
+
+        load_prime_masks(view, first, words, masks);
+
+        for (size_t w = 0; running && w < words; ++w)
+        {
+            uint64_t primes = masks[w];
+            if (0 == primes) continue;
+
+            size_t base = (first + w) * 64 + 1;
+
+            /* numbers of a word are less than 64 apart, so wide gaps only cross words */
+            if (min_gap >= 64)
+            {
+                size_t lowest = base + __builtin_ctzl(primes);
+                if (last && lowest - last >= min_gap)
+                {
+                    ++matches;
+                    running = visit(last, lowest - last, param);
+                }
+                last = base + 63 - __builtin_clzl(primes);
+                continue;
+            }
+
+            for (; running && primes; primes &= primes - 1)
+            {
+                size_t prime = base + __builtin_ctzl(primes);
+                if (last && prime - last >= min_gap)
+                {
+                    ++matches;
+                    running = visit(last, prime - last, param);
+                }
+                last = prime;
+            }
+        }
+    }
+
+    prime_view_close(view);
+    free(masks);
+    return matches;
+}
+
+
+size_t get_lowest_primitive_root(size_t prime)
+{
+    proot_ctx_t ctx = {};
+    return get_lowest_primitive_root_ctx(&ctx, prime);
+}
+
+
+size_t get_lowest_primitive_root_ctx(proot_ctx_t *ctx, size_t prime)
+{
+    proot_entry_t entry;
+    if (find_memoized_proots(prime, &entry)) return entry.lowest;
+
+    find_prime_factors(prime, &ctx->factors);
+
+    return lowest_primitive_root(ctx, prime, &ctx->factors);
+}
+
+
+void walk_primitive_roots(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    proot_visit_t visit, void *param)
+{
+    if (prime < 3)
+    {
+        visit(lowest_root, param);
+        return;
+    }
+
+    find_prime_factors(prime, &ctx->factors);
+    walk_roots(ctx, prime, lowest_root, &ctx->factors, visit, param);
+}
+
+
+void get_primitive_roots(size_t prime, size_t lowest_root, dynarr_t **out)
+{
+    dynarr_clear(*out);
+
+    if (prime < 3)
+    {
+        dynarr_append(out, &lowest_root);
+        return;
+    }
+
+    proot_ctx_t ctx = {};
+    find_prime_factors(prime, &ctx.factors);
+    collect_primitive_roots(&ctx, prime, lowest_root, &ctx.factors);
+
+    for (size_t w = 0; w * 64 < prime; ++w)
+    {
+        for (uint64_t word = ctx.roots[w]; word; word &= word - 1)
+        {
+            size_t root = w * 64 + __builtin_ctzl(word);
+            dynarr_append(out, &root);
+        }
+    }
+
+    free(ctx.roots);
+}
+
+
+size_t get_medium_range_proot(dynarr_t *proots)
+{
+    return *(size_t*)dynarr_get(proots, dynarr_size(proots) / 2);
+}
+
+
+size_t calc_medium_range_proot(size_t prime)
+{
+    proot_ctx_t ctx = {};
+    size_t mid_proot = calc_medium_range_proot_ctx(&ctx, prime);
+
+    free(ctx.roots);
+    return mid_proot;
+}
+
+
+size_t calc_medium_range_proot_ctx(proot_ctx_t *ctx, size_t prime)
+{
+    proot_entry_t entry;
+    if (find_memoized_proots(prime, &entry)) return entry.medium;
+
+    find_prime_factors(prime, &ctx->factors);
+
+    entry.lowest = lowest_primitive_root(ctx, prime, &ctx->factors);
+    if (!entry.lowest)  return 0; /* zero means no primitive roots */
+
+    entry.medium = medium_range_proot(ctx, prime, entry.lowest, &ctx->factors);
+    memoize_proots(prime, &entry);
+
+    return entry.medium;
+}
+
+
+proot_ctx_t *proot_ctx_create(size_t max_prime)
+{
+    proot_ctx_t *ctx = (proot_ctx_t*) calloc(1, sizeof(proot_ctx_t));
+    if (NULL == ctx) exit(EXIT_FAILURE);
+
+    reserve_roots(ctx, max_prime);
+    return ctx;
+}
+
+
+void proot_ctx_destroy(proot_ctx_t *ctx)
+{
+    free(ctx->roots);
+    free(ctx);
+}
+
+
+dynarr_t *create_pair_array(void)
+{
+    dynarr_t *array = dynarr_create(.element_size = sizeof(pair_t));
+    return array;
+}
+
+
+void calc_PMPR_table(size_t begin, size_t end, dynarr_t **out)
+{
+    if (begin < 3) begin = 3; /* 2 has no primitive roots */
+    if (begin > end) return;
+
+    size_t sieving_count;
+    size_t *sieving_primes = sieve_primes_upto(isqrt(end - 1), &sieving_count);
+
+    factorization_t *window = malloc(PMPR_WINDOW_SIZE * sizeof(factorization_t));
+    if (NULL == window) exit(EXIT_FAILURE);
+
+    /* bitmap of roots grows with windows holding primes not memoized yet */
+    proot_ctx_t *ctx = proot_ctx_create(0);
+    dynarr_t *primes = create_primes_array();
+
+    /*
+    * (prime - 1) of every odd prime is even, so the window covers
+    * even numbers of [begin - 1, end - 1], factored all at once.
+    */
+    size_t low = (begin - 1) + (begin - 1) % 2;
+    while (low <= end - 1)
+    {
+        size_t left = (end - 1 - low) / 2 + 1;
+        size_t count = left < PMPR_WINDOW_SIZE ? left : PMPR_WINDOW_SIZE;
+        size_t high = low + 2 * (count - 1);
+
+        dynarr_clear(primes);
+        get_primes_range(low + 1, high + 1, &primes);
+
+        /* window is factored only if some of its primes were not memoized yet */
+        bool factored = false;
+
+        size_t size = dynarr_size(primes);
+        for (size_t i = 0; i < size; ++i)
+        {
+            size_t prime = *(size_t*) dynarr_get(primes, i);
+            proot_entry_t entry;
+
+            if (!find_memoized_proots(prime, &entry))
+            {
+                if (!factored)
+                {
+                    sieve_factor_window(low, count, sieving_primes, sieving_count, window);
+                    reserve_roots(ctx, high + 1);
+                    factored = true;
+                }
+
+                const factorization_t *factors = &window[(prime - 1 - low) / 2];
+
+                entry.lowest = lowest_primitive_root(ctx, prime, factors);
+                if (!entry.lowest) continue; /* skip prime with no primitive roots */
+
+                entry.medium = medium_range_proot(ctx, prime, entry.lowest, factors);
+                memoize_proots(prime, &entry);
+            }
+
+            pair_t *pair = &(pair_t){
+                .first = prime,
+                .second = entry.medium
+            };
+
+            dynarr_append(out, pair);
+        }
+
+        if (count < PMPR_WINDOW_SIZE) break;
+        low = high + 2;
+    }
+
+    dynarr_destroy(primes);
+    proot_ctx_destroy(ctx);
+    free(window);
+    free(sieving_primes);
+}
+
+
+void gen_PMPR_c_header(size_t begin, size_t end, const char *filename)
+{
+    if (filename == NULL) filename = "pmpr.h";
+    assert(MAX_HEADER_NAME_SIZE >= strlen(filename));
+
+    dynarr_t *PMPR_table = create_pair_array();
+    calc_PMPR_table(begin, end, &PMPR_table);
+
+    FILE *file = fopen(filename, "w");
+
+    char include_guard[MAX_HEADER_NAME_SIZE + 2];
+    generate_include_guard(filename, include_guard);
+
+    dynarr_t *contents = dynarr_create(.element_size = 1);
+    generate_table_contents(PMPR_table, &contents);
+
+    fprintf(file,
+        "#ifndef %s\n"
+        "#define %s\n"
+        "%s\n" /* pair definition */
+        "pair_t pmpr_table[] = {\n"
+        "%s" /* table contents */
+        "};\n"
+        "#endif/*%s*/",
+        include_guard,
+        include_guard,
+        pair_definition,
+        (char*)dynarr_first(contents),
+        include_guard
+        );
+    
+    fclose(file);
+    dynarr_destroy(contents);
+    dynarr_destroy(PMPR_table);
+}
+
+
+static int jacobi(size_t a, size_t n)
+{
+    int result = 1;
+    a %= n;
+
+    while (a != 0)
+    {
+        while (a % 2 == 0)
+        {
+            a /= 2;
+            if (n % 8 == 3 || n % 8 == 5) result = -result;
+        }
+
+        size_t temp = a;
+        a = n;
+        n = temp;
+
+        if (a % 4 == 3 && n % 4 == 3) result = -result;
+        a %= n;
+    }
+
+    return n == 1 ? result : 0;
+}
+
+
+static void sieve_range(size_t begin, size_t end, size_t threads, dynarr_t **out)
+{
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t first_segment = begin / 8 / segment_bytes;
+    size_t last_segment = end / 8 / segment_bytes;
+
+    /* the last segment is sieved whole, its end wraps to zero at the top of numbers */
+    size_t root = isqrt((last_segment + 1) * segment_bytes * 8 - 1);
+
+    /* beyond the square of the largest sieving prime the rest is crossed out by buckets */
+    bool buckets = root > MAX_SIEVING_PRIME;
+    const sieving_primes_t *sieving = acquire_sieving_primes(root, buckets ? root : 0);
+
+    /* without `out` cells are only stored */
+    dynarr_t **results = NULL;
+    if (out)
+    {
+        results = (dynarr_t**) malloc(ROUND_SEGMENTS * sizeof(dynarr_t*));
+        if (!results) exit(EXIT_FAILURE);
+    }
+
+    for (size_t segment = first_segment; segment <= last_segment; segment += ROUND_SEGMENTS)
+    {
+        size_t left = last_segment - segment + 1;
+        range_job_t job = {
+            .begin = begin,
+            .end = end,
+            .first_segment = segment,
+            .segments = left < ROUND_SEGMENTS ? left : ROUND_SEGMENTS,
+            .results = results,
+            .sieving = sieving,
+            .buckets = buckets
+        };
+
+        /* segments of the round are written densely, lay them out in one extent */
+        preallocate_cache_range(segment * segment_bytes, job.segments * segment_bytes);
+
+        size_t workers_count[MAX_NUMA_NODES];
+        partition_range_job(&job, threads, workers_count);
+
+        size_t total = 0;
+        for (size_t p = 0; p < job.partitions_count; ++p)
+        {
+            total += workers_count[p];
+
+            /* buckets are carried from a segment to the next one, so each worker takes a run */
+            range_partition_t *partition = &job.partitions[p];
+            if (buckets)
+            {
+                partition->claim = (partition->end - partition->next + workers_count[p] - 1) / workers_count[p];
+            }
+        }
+
+        pthread_t *threads_ids = (pthread_t*) malloc(total * sizeof(pthread_t));
+        range_worker_t *workers = (range_worker_t*) malloc(total * sizeof(range_worker_t));
+        if (!threads_ids || !workers) exit(EXIT_FAILURE);
+
+        size_t t = 0;
+        for (size_t p = 0; p < job.partitions_count; ++p)
+        {
+            for (size_t w = 0; w < workers_count[p]; ++w, ++t)
+            {
+                workers[t] = (range_worker_t){
+                    .job = &job,
+                    .partition = &job.partitions[p],
+                    .fd = -1,
+                    .file_idx = -1ul
+                };
+                if (0 != pthread_create(&threads_ids[t], NULL, range_worker, &workers[t]))
+                {
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+        for (t = 0; t < total; ++t)
+        {
+            pthread_join(threads_ids[t], NULL);
+        }
+
+        free(workers);
+        free(threads_ids);
+
+        /* merge in order */
+        for (size_t i = 0; out && i < job.segments; ++i)
+        {
+            size_t size = dynarr_size(results[i]);
+            for (size_t j = 0; j < size; ++j)
+            {
+                dynarr_append(out, dynarr_get(results[i], j));
+            }
+            dynarr_destroy(results[i]);
+        }
+
+        if (left <= ROUND_SEGMENTS) break;
+    }
+
+    release_sieving_primes();
+    free(results);
+    note_access(last_segment);
+}
+
+
+static void partition_range_job(range_job_t *job, size_t threads, size_t *workers)
+{
+    if (!s_numa_mode)
+    {
+        if (0 == threads) threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (0 == threads) threads = 1;
+
+        job->partitions_count = 1;
+        job->partitions[0] = (range_partition_t){ .next = 0, .end = job->segments, .claim = 1, .node = NULL };
+        workers[0] = threads < job->segments ? threads : job->segments;
+        return;
+    }
+
+    size_t cpus = 0;
+    for (size_t n = 0; n < s_numa_topology.count; ++n)
+    {
+        cpus += s_numa_topology.nodes[n].cpu_count;
+    }
+    if (0 == threads) threads = cpus;
+
+    /* every node taking part has a worker, with fewer threads than nodes only the first ones do */
+    size_t nodes = s_numa_topology.count < job->segments ? s_numa_topology.count : job->segments;
+    if (nodes > threads) nodes = threads;
+
+    cpus = 0;
+    for (size_t n = 0; n < nodes; ++n)
+    {
+        cpus += s_numa_topology.nodes[n].cpu_count;
+    }
+
+    /* the rest of workers is spread over the nodes proportionally to their cpus */
+    size_t spare = threads - nodes;
+    size_t assigned = 0;
+    size_t next = 0;
+
+    job->partitions_count = nodes;
+    for (size_t n = 0; n < nodes; ++n)
+    {
+        const numa_node_t *node = &s_numa_topology.nodes[n];
+
+        size_t node_workers = 1 + spare * node->cpu_count / cpus;
+
+        /* contiguous run of segments sized by the share of workers */
+        assigned += node->cpu_count;
+        size_t end = (n + 1 == nodes) ? job->segments : job->segments * assigned / cpus;
+        if (end <= next) end = next + 1;
+
+        job->partitions[n] = (range_partition_t){ .next = next, .end = end, .claim = 1, .node = node };
+        workers[n] = node_workers < end - next ? node_workers : end - next;
+        next = end;
+    }
+}
+
+
+static void take_buckets(const range_job_t *job, size_t first, size_t last, bucket_sieve_t *buckets)
+{
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t segment = job->first_segment + first;
+
+    pthread_mutex_lock(&s_buckets_lock);
+    bool resumed = NULL != s_buckets.buckets && s_buckets_segment == segment;
+    if (resumed)
+    {
+        *buckets = s_buckets;
+        s_buckets = (bucket_sieve_t){};
+        s_buckets_segment = -1ul;
+    }
+    pthread_mutex_unlock(&s_buckets_lock);
+
+    if (resumed)
+    {
+        /* large primes grow only by larger ones, their squares are past the buckets */
+        bucket_sieve_extend(buckets, job->sieving->large, job->sieving->large_count);
+        stats_add(STATS_BUCKETS_RESUMED, 1);
+        return;
+    }
+
+    size_t low = segment * segment_bytes * 8 + 1;
+    size_t count = segment_bytes * 4;
+    size_t segments = last - first;
+    if (last == job->segments)
+    {
+        /* up to the top of numbers */
+        segments = (SIZE_MAX - low) / 2 / count + 1;
+    }
+
+    bucket_sieve_init(buckets, low, count, segments, job->sieving->large, job->sieving->large_count);
+}
+
+
+static void keep_buckets(const range_job_t *job, size_t last, bucket_sieve_t *buckets)
+{
+    if (last != job->segments)
+    {
+        bucket_sieve_free(buckets);
+        return;
+    }
+
+    pthread_mutex_lock(&s_buckets_lock);
+    bucket_sieve_t previous = s_buckets;
+    s_buckets = *buckets;
+    s_buckets_segment = job->first_segment + last;
+    pthread_mutex_unlock(&s_buckets_lock);
+
+    if (previous.buckets) bucket_sieve_free(&previous);
+}
+
+
+static void *range_worker(void *param)
+{
+    range_worker_t *worker = (range_worker_t*) param;
+    range_job_t *job = worker->job;
+    range_partition_t *partition = worker->partition;
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+
+    if (partition->node) numa_pin_thread(partition->node);
+
+    worker->composite = (uint64_t*) malloc(segment_bytes * 4 / 8);
+    if (NULL == worker->composite) exit(EXIT_FAILURE);
+
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    size_t segments = 0;
+    size_t numbers = 0;
+
+    for (;;)
+    {
+        size_t first = __atomic_fetch_add(&partition->next, partition->claim, __ATOMIC_RELAXED);
+        if (first >= partition->end) break;
+
+        size_t last = partition->end - first > partition->claim ? first + partition->claim : partition->end;
+
+        /* segments are never shorter than a full one, those of a run are consecutive */
+        bucket_sieve_t buckets;
+        if (job->buckets) take_buckets(job, first, last, &buckets);
+
+        for (size_t i = first; i < last; ++i)
+        {
+            size_t first_byte = (job->first_segment + i) * segment_bytes;
+
+            /* segments never cross file boundary */
+            size_t length = FILE_CAPACITY - first_byte % FILE_CAPACITY;
+            if (length > segment_bytes) length = segment_bytes;
+
+            /*
+            * Page cache of the file is allocated by the first touch, pages not in memory yet
+            * are faulted in by this pinned worker and land on its node. Pages already cached
+            * stay where they are, mbind(2) does not move pages of shared file mappings.
+            */
+            char *region = map_cache_region(worker, first_byte, length);
+            thaw_cache_region(region, first_byte);
+
+            /* pages recorded as complete need no scan of their cells */
+            if (!is_region_recorded(first_byte, length) && !is_region_complete(region, length))
+            {
+                fill_cache_region(region, first_byte, length, job->sieving,
+                    job->buckets ? &buckets : NULL, worker->composite);
+                stats_add(STATS_SEGMENTS_SIEVED, 1);
+            }
+            else
+            {
+                if (job->buckets) bucket_sieve_next(&buckets, NULL);
+                stats_add(STATS_SEGMENTS_COMPLETE, 1);
+            }
+
+            /* cells are stored to the shared mapping, publish them to reader processes */
+            size_t file_idx = first_byte / FILE_CAPACITY;
+            segment_states_mark(get_segment_states(file_idx), first_byte % FILE_CAPACITY / segment_bytes);
+            record_complete_pages(region, first_byte, length);
+
+            if (job->results)
+            {
+                job->results[i] = create_primes_array();
+                collect_region_primes(region, first_byte, length, job->begin, job->end, &job->results[i]);
+            }
+
+            unmap_cache_region(region, length);
+
+            ++segments;
+            numbers += length * 8;
+        }
+
+        if (job->buckets) keep_buckets(job, last, &buckets);
+    }
+
+    if (partition->node)
+    {
+        struct timespec finished;
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        size_t nanoseconds = (finished.tv_sec - started.tv_sec) * 1000000000ul
+            + finished.tv_nsec - started.tv_nsec;
+
+        numa_node_stats_t *stats = &s_numa_stats[partition->node - s_numa_topology.nodes];
+        __atomic_add_fetch(&stats->segments, segments, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->numbers, numbers, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->nanoseconds, nanoseconds, __ATOMIC_RELAXED);
+    }
+
+    if (-1 != worker->fd) close(worker->fd);
+    free(worker->composite);
+    return NULL;
+}
+
+
+static char *map_cache_region(range_worker_t *worker, size_t first_byte, size_t length)
+{
+    size_t file_idx = first_byte / FILE_CAPACITY;
+    size_t file_offset = first_byte % FILE_CAPACITY;
+
+    if (worker->file_idx != file_idx)
+    {
+        if (-1 != worker->fd) close(worker->fd);
+        worker->fd = open_cache_file(file_idx);
+        worker->file_idx = file_idx;
+    }
+
+    extend_cache_file(file_idx, worker->fd, file_offset + length);
+
+    return map_cache_file_region(worker->fd, file_idx, file_offset, length);
+}
+
+
+static char *map_cache_file_region(int fd, size_t file_idx, size_t file_offset, size_t length)
+{
+    return mem_budget_acquire(&s_mem_budget, file_idx, file_offset, length, fd);
+}
+
+
+static void unmap_cache_region(char *region, size_t length)
+{
+    /* pool unmaps regions it does not keep */
+    if (!mem_budget_release(&s_mem_budget, region)) munmap(region, length);
+}
+
+
+static void fill_cache_region(char *region, size_t first_byte, size_t length,
+    const sieving_primes_t *sieving, bucket_sieve_t *buckets, uint64_t *composite)
+{
+    size_t low = first_byte * 8 + 1;
+    size_t count = length * 4;
+    size_t high = low + 2 * (count - 1);
+
+    sieve_odd_segment(low, count, sieving->primes, sieving->count, composite);
+    if (buckets) bucket_sieve_next(buckets, composite);
+
+    /* numbers not crossed out are primes only if sieve went up to the square root */
+    bool complete = sieving->limit >= isqrt(high) || (buckets && sieving->large_limit >= isqrt(high));
+
+    uint64_t *words = (uint64_t*) region;
+    for (size_t w = 0; w < length / sizeof(uint64_t); ++w)
+    {
+        uint64_t cells = __atomic_load_n(&words[w], __ATOMIC_RELAXED);
+        uint64_t undefined = ~(cells | cells >> 1) & 0x5555555555555555ul;
+        uint64_t defined = 0;
+
+        for (; undefined; undefined &= undefined - 1)
+        {
+            size_t cell = __builtin_ctzl(undefined) / 2;
+            size_t idx = w * 32 + cell;
+            size_t number = low + 2 * idx;
+            bool prime = !((composite[idx / 64] >> (idx % 64)) & 1)
+                && number != 1
+                && (complete || is_prime(number));
+
+            defined |= (uint64_t) (prime ? PRIME : NOT_PRIME) << (2 * cell);
+        }
+
+        /* cells only turn from undefined to their final value, so concurrent writers never conflict */
+        if (defined) __atomic_fetch_or(&words[w], defined, __ATOMIC_RELAXED);
+    }
+}
+
+
+static bool is_region_complete(const char *region, size_t length)
+{
+    const uint64_t *words = (const uint64_t*) region;
+
+    /* every cell has at least one of its bits set */
+    for (size_t i = 0; i < length / sizeof(uint64_t); ++i)
+    {
+        if (((words[i] | words[i] >> 1) & 0x5555555555555555ul) != 0x5555555555555555ul)
+        {
             return false;
         }
     }
+    return true;
+}
+
+
+static void collect_region_primes(const char *region, size_t first_byte, size_t length,
+    size_t begin, size_t end, dynarr_t **out)
+{
+    const uint64_t *words = (const uint64_t*) region;
+    size_t first_odd_idx = first_byte * 4;
+
+    for (size_t i = 0; i < length / sizeof(uint64_t); ++i)
+    {
+        /* low bit of each PRIME (01) cell */
+        uint64_t primes = words[i] & ~(words[i] >> 1) & 0x5555555555555555ul;
+
+        for (; primes; primes &= primes - 1)
+        {
+            size_t odd_idx = first_odd_idx + i * 32 + __builtin_ctzl(primes) / 2;
+            size_t number = 2 * odd_idx + 1;
+
+            if (number < begin) continue;
+            if (number > end) return;
+
+            dynarr_append(out, &number);
+        }
+    }
+}
+
+
+static void *get_file_entry(file_table_t *table, size_t file_idx, bool create, open_file_entry_t open_entry)
+{
+    /* files known to have no entry are not opened again either, unless it is created */
+    void **entries = __atomic_load_n(&table->chunks[file_idx / FILE_TABLE_CHUNK], __ATOMIC_ACQUIRE);
+    void *entry = entries ? __atomic_load_n(&entries[file_idx % FILE_TABLE_CHUNK], __ATOMIC_ACQUIRE) : NULL;
+    if (entry && !(create && &s_absent_entry == entry)) return &s_absent_entry == entry ? NULL : entry;
+
+    pthread_mutex_lock(&s_states_lock);
+
+    void ***chunk = &table->chunks[file_idx / FILE_TABLE_CHUNK];
+    if (NULL == *chunk)
+    {
+        void **entries = (void**) calloc(FILE_TABLE_CHUNK, sizeof(void*));
+        if (NULL == entries) exit(EXIT_FAILURE);
+
+        __atomic_store_n(chunk, entries, __ATOMIC_RELEASE);
+    }
+
+    /* another thread may have opened it meanwhile */
+    void **slot = &(*chunk)[file_idx % FILE_TABLE_CHUNK];
+    entry = *slot;
+    if (NULL == entry || (create && &s_absent_entry == entry))
+    {
+        entry = open_entry(file_idx, create);
+        if (NULL == entry) entry = &s_absent_entry;
+
+        /* pairs with the acquire load of `find_file_entry`, the entry is initialized before */
+        __atomic_store_n(slot, entry, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&s_states_lock);
+    return &s_absent_entry == entry ? NULL : entry;
+}
+
+
+static void *find_file_entry(const file_table_t *table, size_t file_idx)
+{
+    void **entries = __atomic_load_n(&table->chunks[file_idx / FILE_TABLE_CHUNK], __ATOMIC_ACQUIRE);
+    if (NULL == entries) return NULL;
+
+    void *entry = __atomic_load_n(&entries[file_idx % FILE_TABLE_CHUNK], __ATOMIC_ACQUIRE);
+    return &s_absent_entry == entry ? NULL : entry;
+}
+
+
+static void close_file_table(file_table_t *table, close_file_entry_t close_entry)
+{
+    for (size_t c = 0; c < MAX_CACHE_FILES / FILE_TABLE_CHUNK; ++c)
+    {
+        if (NULL == table->chunks[c]) continue;
+
+        for (size_t i = 0; i < FILE_TABLE_CHUNK; ++i)
+        {
+            void *entry = table->chunks[c][i];
+            if (entry && &s_absent_entry != entry) close_entry(entry);
+        }
+
+        free(table->chunks[c]);
+        table->chunks[c] = NULL;
+    }
+}
+
+
+static segment_states_t *get_segment_states(size_t file_idx)
+{
+    return (segment_states_t*) get_file_entry(&s_segment_states, file_idx, true, open_segment_states);
+}
+
+
+static void *open_segment_states(size_t file_idx, bool create)
+{
+    char filename[MAX_STATE_FILENAME_SIZE];
+    format_state_filename(file_idx, STATE_FILENAME_SUFFIX, filename);
+
+    /* lookups do not spread sidecars over files nothing was stored to */
+    if (!create && -1 == access(filename, F_OK)) return NULL;
+
+    segment_states_t *states = (segment_states_t*) malloc(sizeof(segment_states_t));
+    if (NULL == states) exit(EXIT_FAILURE);
+
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    segment_states_open(states, filename, segment_bytes, FILE_CAPACITY / segment_bytes, true);
+    return states;
+}
+
+
+static void close_segment_states(void *entry)
+{
+    segment_states_close((segment_states_t*) entry);
+    free(entry);
+}
+
+
+static void format_state_filename(size_t file_idx, const char *suffix, char *out)
+{
+    if (MAX_STATE_FILENAME_SIZE <= snprintf(out, MAX_STATE_FILENAME_SIZE, "%s.%zu%s",
+        FILENAME_PREFIX, file_idx, suffix))
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+static page_states_t *get_page_states(size_t file_idx)
+{
+    return (page_states_t*) get_file_entry(&s_page_states, file_idx, true, open_page_states);
+}
+
+
+static void *open_page_states(size_t file_idx, bool create)
+{
+    char filename[MAX_STATE_FILENAME_SIZE];
+    format_state_filename(file_idx, PAGES_FILENAME_SUFFIX, filename);
+
+    /* lookups do not spread sidecars over files nothing was stored to */
+    if (!create && -1 == access(filename, F_OK)) return NULL;
+
+    page_states_t *states = (page_states_t*) malloc(sizeof(page_states_t));
+    if (NULL == states) exit(EXIT_FAILURE);
+
+    page_states_open(states, filename, s_page_size, FILE_CAPACITY / s_page_size, true);
+    return states;
+}
+
+
+static void close_page_states(void *entry)
+{
+    page_states_close((page_states_t*) entry);
+    free(entry);
+}
+
+
+static void record_complete_pages(const char *region, size_t first_byte, size_t length)
+{
+    page_states_t *states = get_page_states(first_byte / FILE_CAPACITY);
+    size_t first_page = first_byte % FILE_CAPACITY / s_page_size;
+
+    for (size_t p = 0; p < length / s_page_size; ++p)
+    {
+        if (PAGE_COMPLETE == page_states_get(states, first_page + p)) continue;
+
+        const uint64_t *words = (const uint64_t*) (region + p * s_page_size);
+        uint32_t primes = 0;
+        for (size_t i = 0; i < s_page_size / sizeof(uint64_t); ++i)
+        {
+            primes += __builtin_popcountl(words[i] & ~(words[i] >> 1) & 0x5555555555555555ul);
+        }
+
+        page_states_complete(states, first_page + p, primes);
+    }
+}
+
+
+static bool is_region_recorded(size_t first_byte, size_t length)
+{
+    /* cells of frozen segments are punched out, whatever the directory says */
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    cold_store_t *store = get_cold_store(first_byte / FILE_CAPACITY, false);
+    for (size_t byte = first_byte; store && byte < first_byte + length; byte += segment_bytes)
+    {
+        if (cold_store_is_frozen(store, byte % FILE_CAPACITY / segment_bytes)) return false;
+    }
+
+    page_states_t *states = get_page_states(first_byte / FILE_CAPACITY);
+    size_t first_page = first_byte % FILE_CAPACITY / s_page_size;
+
+    for (size_t p = 0; p < length / s_page_size; ++p)
+    {
+        if (PAGE_COMPLETE != page_states_get(states, first_page + p)) return false;
+    }
+    return true;
+}
+
+
+static void touch_cache_page(size_t byte_offset)
+{
+    page_states_t *states = get_page_states(byte_offset / FILE_CAPACITY);
+    page_states_touch(states, byte_offset % FILE_CAPACITY / s_page_size);
+}
+
+
+static cold_store_t *get_cold_store(size_t file_idx, bool create)
+{
+    return (cold_store_t*) get_file_entry(&s_cold_stores, file_idx, create, open_cold_store);
+}
+
+
+static void *open_cold_store(size_t file_idx, bool create)
+{
+    char prefix[MAX_FILENAME_SIZE];
+    if (MAX_FILENAME_SIZE < sprintf(prefix, "%s.%zu", FILENAME_PREFIX, file_idx))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    cold_store_t *store = (cold_store_t*) malloc(sizeof(cold_store_t));
+    if (NULL == store) exit(EXIT_FAILURE);
+
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    if (!cold_store_open(store, prefix, segment_bytes, FILE_CAPACITY / segment_bytes, create))
+    {
+        free(store);
+        return NULL;
+    }
+    return store;
+}
+
+
+static void close_cold_store(void *entry)
+{
+    cold_store_close((cold_store_t*) entry);
+    free(entry);
+}
+
+
+static bool thaw_cache_region(char *region, size_t first_byte)
+{
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t segment = first_byte % FILE_CAPACITY / segment_bytes;
+
+    cold_store_t *store = get_cold_store(first_byte / FILE_CAPACITY, false);
+    if (NULL == store || !cold_store_is_frozen(store, segment)) return false;
+
+    cold_store_thaw(store, segment, region);
+    stats_add(STATS_SEGMENTS_THAWED, 1);
+    return true;
+}
+
+
+static void thaw_cache_page(cache_t *cache, size_t file_offset)
+{
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t segment = file_offset / segment_bytes;
+
+    cold_store_t *store = get_cold_store(cache->file_idx, false);
+    if (NULL == store || !cold_store_is_frozen(store, segment)) return;
+
+    extend_cache_file(cache->file_idx, cache->fd, (segment + 1) * segment_bytes);
+
+    char *region = map_cache_file_region(cache->fd, cache->file_idx, segment * segment_bytes, segment_bytes);
+
+    cold_store_thaw(store, segment, region);
+    stats_add(STATS_SEGMENTS_THAWED, 1);
+
+    unmap_cache_region(region, segment_bytes);
+}
+
+
+static const uint64_t *get_view_word(const prime_view_t *view, size_t number)
+{
+    size_t byte = number / 8;
+    size_t span = byte / FILE_CAPACITY - view->first_byte / FILE_CAPACITY;
+    size_t first_byte = (view->spans[span].first_number - 1) / 8;
+
+    return &view->spans[span].words[(byte - first_byte) / sizeof(uint64_t)];
+}
+
+
+static size_t count_view_primes(const prime_view_t *view, size_t number)
+{
+    size_t page = (number / 8 - view->first_byte) / s_page_size;
+    size_t page_number = (view->first_byte + page * s_page_size) * 8 + 1;
+
+    const uint64_t *words = get_view_word(view, page_number);
+    size_t last = (number - page_number) / 2; /* cell within the page */
+    size_t count = view->ranks[page];
+
+    for (size_t i = 0; i < last / 32; ++i)
+    {
+        count += __builtin_popcountl(words[i] & ~(words[i] >> 1) & 0x5555555555555555ul);
+    }
+
+    /* cells up to and including the last one */
+    uint64_t word = words[last / 32];
+    uint64_t mask = (last % 32 == 31) ? ~0ul : (1ul << (2 * (last % 32 + 1))) - 1;
+    count += __builtin_popcountl(word & ~(word >> 1) & 0x5555555555555555ul & mask);
+
+    return count;
+}
+
+
+static void load_prime_masks(const prime_view_t *view, size_t first_word, size_t count, uint64_t *masks)
+{
+    memset(masks, 0, count * sizeof(uint64_t));
+
+    size_t low = view->begin > first_word * 64 ? view->begin : first_word * 64;
+    size_t last_word = view->end / 64 - first_word < count ? view->end / 64 : first_word + count - 1;
+    size_t high = last_word == view->end / 64 ? view->end : last_word * 64 + 63;
+    if (low > high) return;
+
+    for (size_t i = 0; i < view->spans_count; ++i)
+    {
+        const prime_span_t *span = &view->spans[i];
+        size_t span_word = span->first_number / 64;
+        size_t from = span_word > first_word ? span_word : first_word;
+        size_t to = span_word + span->words_count - 1 < last_word ? span_word + span->words_count - 1 : last_word;
+
+        for (size_t w = from; w <= to; ++w)
+        {
+            uint64_t word = span->words[w - span_word];
+            masks[w - first_word] = word & ~(word >> 1) & 0x5555555555555555ul;
+        }
+    }
+
+    /* cells around the range may hold primes calculated before */
+    size_t below = low % 64 ? low % 64 - 1 : 0;
+    masks[low / 64 - first_word] &= ~0ul << below;
+    masks[high / 64 - first_word] &= high % 64 ? (2ul << (high % 64 - 1)) - 1 : 0;
+}
+
+
+static reader_file_t *get_reader_file(cache_reader_t *reader, size_t file_idx)
+{
+    if (file_idx >= reader->files_count)
+    {
+        size_t count = file_idx + 1;
+        reader_file_t *files = (reader_file_t*) realloc(reader->files, count * sizeof(reader_file_t));
+        if (NULL == files) exit(EXIT_FAILURE);
+
+        for (size_t i = reader->files_count; i < count; ++i)
+        {
+            files[i] = (reader_file_t){ .fd = -1 };
+        }
+        reader->files = files;
+        reader->files_count = count;
+    }
+
+    reader_file_t *file = &reader->files[file_idx];
+    if (file->has_states) return file;
+
+    /* writer may have created files since the last attempt */
+    if (-1 == file->fd)
+    {
+        char filename[MAX_FILENAME_SIZE];
+        if (MAX_FILENAME_SIZE < sprintf(filename, "%s.%zu", FILENAME_PREFIX, file_idx))
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        file->fd = open(filename, O_RDONLY);
+        if (-1 == file->fd) return NULL;
+    }
+
+    char filename[MAX_STATE_FILENAME_SIZE];
+    format_state_filename(file_idx, STATE_FILENAME_SUFFIX, filename);
+
+    file->has_states = segment_states_open(&file->states, filename,
+        reader->segment_bytes, FILE_CAPACITY / reader->segment_bytes, false);
+
+    return file->has_states ? file : NULL;
+}
+
+
+static bool map_reader_file(reader_file_t *file, size_t limit)
+{
+    if (limit <= file->mapped) return true;
+
+    struct stat st;
+    if (-1 == fstat(file->fd, &st)) exit(EXIT_FAILURE);
+    if ((size_t) st.st_size < limit) return false;
+
+    /* mapping may move, pointers into it are not kept between calls */
+    void *data = file->mapped
+        ? mremap((void*) file->data, file->mapped, st.st_size, MREMAP_MAYMOVE)
+        : mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (MAP_FAILED == data) exit(EXIT_FAILURE);
+
+    file->data = (const char*) data;
+    file->mapped = st.st_size;
+    return true;
+}
+
+
+static void note_access(size_t segment)
+{
+    read_ahead_t *ra = &s_read_ahead;
+    if (!ra->running) return;
+
+    /* range jobs of several threads report their accesses too */
+    pthread_mutex_lock(&ra->lock);
+
+    long stride = (long) (segment - ra->last_segment);
+    if (0 == stride)
+    {
+        pthread_mutex_unlock(&ra->lock);
+        return;
+    }
+    ra->last_segment = segment;
+
+    if (stride != ra->stride)
+    {
+        ra->stride = stride;
+        ra->confidence = 0;
+        ra->scheduled = segment;
+        pthread_mutex_unlock(&ra->lock);
+        return;
+    }
+
+    if (labs(stride) > READ_AHEAD_MAX_STRIDE || ++ra->confidence < READ_AHEAD_CONFIDENCE)
+    {
+        pthread_mutex_unlock(&ra->lock);
+        return;
+    }
+
+    for (size_t k = 1; k <= READ_AHEAD_DEPTH; ++k)
+    {
+        if (stride < 0 && segment < k * -stride) break;
+
+        size_t next = segment + k * stride;
+        if (stride > 0 ? next <= ra->scheduled : next >= ra->scheduled) continue;
+
+        /* queue is full, the worker is behind anyway */
+        if (ra->tail - ra->head == READ_AHEAD_QUEUE) break;
+
+        ra->queue[ra->tail++ % READ_AHEAD_QUEUE] = next;
+        ra->scheduled = next;
+    }
+
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->lock);
+}
+
+
+static void *read_ahead_worker(void *param)
+{
+    read_ahead_t *ra = (read_ahead_t*) param;
+
+    pthread_mutex_lock(&ra->lock);
+    while (ra->running)
+    {
+        if (ra->head == ra->tail)
+        {
+            pthread_cond_wait(&ra->wake, &ra->lock);
+            continue;
+        }
+
+        size_t segment = ra->queue[ra->head++ % READ_AHEAD_QUEUE];
+
+        pthread_mutex_unlock(&ra->lock);
+        prepare_segment(ra, segment);
+        pthread_mutex_lock(&ra->lock);
+    }
+    pthread_mutex_unlock(&ra->lock);
+
+    return NULL;
+}
+
+
+static void prepare_segment(read_ahead_t *ra, size_t segment)
+{
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t first_byte = segment * segment_bytes;
+    size_t file_offset = first_byte % FILE_CAPACITY;
+
+    char *region = map_cache_region(&ra->worker, first_byte, segment_bytes);
+
+    /* start reading stored pages from disk before they are touched */
+    posix_fadvise(ra->worker.fd, file_offset, segment_bytes, POSIX_FADV_WILLNEED);
+    madvise(region, segment_bytes, MADV_WILLNEED);
+
+    thaw_cache_region(region, first_byte);
+
+    bool complete = is_region_complete(region, segment_bytes);
+    if (!complete && reserve_sieving_primes_for(&ra->sieving, (first_byte + segment_bytes) * 8))
+    {
+        fill_cache_region(region, first_byte, segment_bytes, &ra->sieving, NULL, ra->worker.composite);
+        complete = true;
+    }
+
+    if (complete)
+    {
+        segment_states_mark(get_segment_states(first_byte / FILE_CAPACITY), file_offset / segment_bytes);
+        record_complete_pages(region, first_byte, segment_bytes);
+    }
+
+    unmap_cache_region(region, segment_bytes);
+    stats_add(STATS_SEGMENTS_READ_AHEAD, 1);
+}
+
+
+static size_t next_l1_prime(const l1_cache_t *l1, size_t number)
+{
+    size_t idx = number / 2;
+    size_t words = sieve_odd_bitset_words(l1->limit);
+
+    /* bits past the limit are cleared by the sieve */
+    uint64_t word = l1->bits[idx / 64] & (-1ul << (idx % 64));
+    for (size_t w = idx / 64; ; )
+    {
+        if (word) return 2 * (w * 64 + __builtin_ctzl(word)) + 1;
+        if (++w == words) return 0;
+        word = l1->bits[w];
+    }
+}
+
+
+static size_t prev_l1_prime(const l1_cache_t *l1, size_t number)
+{
+    size_t idx = number / 2;
+
+    uint64_t word = l1->bits[idx / 64] & (-1ul >> (63 - idx % 64));
+    for (size_t w = idx / 64; ; )
+    {
+        if (word) return 2 * (w * 64 + 63 - __builtin_clzl(word)) + 1;
+        if (0 == w--) return 0;
+        word = l1->bits[w];
+    }
+}
+
+
+static size_t next_cached_prime(cache_t *cache, size_t number)
+{
+    size_t page_words = s_page_size / sizeof(uint64_t);
+
+    for (size_t odd_idx = number / 2; odd_idx < SIZE_MAX / 2; )
+    {
+        size_t byte_offset = odd_idx / 4;
+        open_page(cache, byte_offset);
+
+        const uint64_t *words = (const uint64_t*) cache->page;
+        size_t first_odd_idx = cache->page_offset * 4;
+
+        /* cells of the first word below `number` are skipped */
+        uint64_t mask = 0x5555555555555555ul << (2 * (odd_idx % 32));
+
+        for (size_t w = byte_offset % s_page_size / sizeof(uint64_t); w < page_words; ++w)
+        {
+            uint64_t defined = (words[w] | words[w] >> 1) & mask;
+            if (defined != mask) fill_navigation_window(cache, w, true);
+
+            /* low bit of each PRIME (01) cell */
+            uint64_t primes = words[w] & ~(words[w] >> 1) & mask;
+            if (primes)
+            {
+                return 2 * (first_odd_idx + w * 32 + __builtin_ctzl(primes) / 2) + 1;
+            }
+
+            mask = 0x5555555555555555ul;
+        }
+
+        odd_idx = first_odd_idx + s_page_size * 4;
+    }
+
+    return 0;
+}
 
-    for (size_t k = 0, p = 4; p <= sqrt(number); ++k, p = 6 * k)
+
+static size_t prev_cached_prime(cache_t *cache, size_t number, size_t floor)
+{
+    size_t floor_idx = floor / 2;
+
+    for (size_t odd_idx = number / 2; odd_idx >= floor_idx; )
     {
-        if (number % (p + 1) == 0
-         || number % (p + 5) == 0)
+        size_t byte_offset = odd_idx / 4;
+        open_page(cache, byte_offset);
+
+        const uint64_t *words = (const uint64_t*) cache->page;
+        size_t first_odd_idx = cache->page_offset * 4;
+
+        /* cells of the first word above `number` are skipped */
+        uint64_t mask = 0x5555555555555555ul >> (2 * (31 - odd_idx % 32));
+
+        for (size_t w = byte_offset % s_page_size / sizeof(uint64_t) + 1; w-- > 0; )
         {
-            return false;
+            size_t word_idx = first_odd_idx + w * 32;
+
+            /* cells below the floor belong to the bitset */
+            if (word_idx + 31 < floor_idx) return 0;
+            if (word_idx < floor_idx) mask &= 0x5555555555555555ul << (2 * (floor_idx - word_idx));
+
+            uint64_t defined = (words[w] | words[w] >> 1) & mask;
+            if (defined != mask) fill_navigation_window(cache, w, false);
+
+            uint64_t primes = words[w] & ~(words[w] >> 1) & mask;
+            if (primes)
+            {
+                return 2 * (word_idx + (63 - __builtin_clzl(primes)) / 2) + 1;
+            }
+
+            mask = 0x5555555555555555ul;
         }
+
+        if (0 == first_odd_idx) break;
+        odd_idx = first_odd_idx - 1;
+    }
+
+    return 0;
+}
+
+
+static void fill_navigation_window(cache_t *cache, size_t word, bool forward)
+{
+    size_t page_words = s_page_size / sizeof(uint64_t);
+    size_t number = 2 * (cache->page_offset * 4 + word * 32) + 1;
+
+    /*
+    * word holds 32 odd numbers, i.e. spans 64 integers.
+    * Each sieving prime costs a division per window, so the window covers
+    * at least as many odd numbers as there are sieving primes.
+    */
+    size_t gap = (size_t) log((double) number) + 1;
+    size_t window = (NAVIGATION_GAPS * gap + 63) / 64;
+
+    const sieving_primes_t *sieving = acquire_sieving_primes_for(number + s_page_size * 8);
+    if (NULL == sieving)
+    {
+        /* survivors of the sieve are tested by trial division, so only the expected gaps are filled */
+        sieving = acquire_sieving_primes(MAX_SIEVING_PRIME, 0);
+    }
+    else if (window < sieving->count / 32)
+    {
+        window = sieving->count / 32;
+    }
+    if (window > page_words) window = page_words;
+
+    size_t first = forward ? word : (word + 1 >= window ? word + 1 - window : 0);
+    if (first + window > page_words) window = page_words - first;
+
+    fill_cache_region(cache->page + first * sizeof(uint64_t),
+        cache->page_offset + first * sizeof(uint64_t),
+        window * sizeof(uint64_t),
+        sieving,
+        NULL,
+        s_block_composite);
+    release_sieving_primes();
+
+    if (window == page_words)
+    {
+        record_complete_pages(cache->page, cache->page_offset, s_page_size);
     }
+    else
+    {
+        touch_cache_page(cache->page_offset);
+    }
+}
+
 
+static bool reserve_sieving_primes_for(sieving_primes_t *sieving, size_t high)
+{
+    size_t limit = isqrt(high);
+    if (limit > MAX_SIEVING_PRIME) return false;
+
+    reserve_sieving_primes(sieving, limit);
     return true;
 }
 
 
-void init_cache(void)
+static const sieving_primes_t *acquire_sieving_primes(size_t limit, size_t large_limit)
+{
+    if (limit > MAX_SIEVING_PRIME) limit = MAX_SIEVING_PRIME;
+    if (large_limit > MAX_BUCKET_PRIME) large_limit = MAX_BUCKET_PRIME;
+
+    for (;;)
+    {
+        pthread_rwlock_rdlock(&s_sieving_lock);
+        if (s_sieving.primes && limit <= s_sieving.limit && large_limit <= s_sieving.large_limit) return &s_sieving;
+        pthread_rwlock_unlock(&s_sieving_lock);
+
+        /* readers are gone while the arrays are reallocated, limits are checked again after */
+        pthread_rwlock_wrlock(&s_sieving_lock);
+        reserve_sieving_primes(&s_sieving, limit);
+        if (large_limit) reserve_bucket_primes(&s_sieving, large_limit);
+        pthread_rwlock_unlock(&s_sieving_lock);
+    }
+}
+
+
+static void release_sieving_primes(void)
+{
+    pthread_rwlock_unlock(&s_sieving_lock);
+}
+
+
+static const sieving_primes_t *acquire_sieving_primes_for(size_t high)
+{
+    size_t limit = isqrt(high);
+    if (limit > MAX_SIEVING_PRIME) return NULL;
+
+    return acquire_sieving_primes(limit, 0);
+}
+
+
+static void reserve_sieving_primes(sieving_primes_t *sieving, size_t limit)
+{
+    if (limit > MAX_SIEVING_PRIME) limit = MAX_SIEVING_PRIME;
+    if (sieving->primes && limit <= sieving->limit) return;
+
+    if (NULL == sieving->primes)
+    {
+        sieving->primes = sieve_primes_upto(limit, &sieving->count);
+        sieving->limit = limit;
+        return;
+    }
+
+    /* only primes above those already known are sieved */
+    size_t count;
+    uint32_t *primes = sieve_primes_between(sieving->limit, limit, &count);
+
+    size_t *grown = (size_t*) realloc(sieving->primes, (sieving->count + count) * sizeof(size_t));
+    if (NULL == grown) exit(EXIT_FAILURE);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        grown[sieving->count + i] = primes[i];
+    }
+    free(primes);
+
+    sieving->primes = grown;
+    sieving->count += count;
+    sieving->limit = limit;
+}
+
+
+static void reserve_bucket_primes(sieving_primes_t *sieving, size_t limit)
+{
+    if (limit > MAX_BUCKET_PRIME) limit = MAX_BUCKET_PRIME;
+    if (limit <= sieving->large_limit) return;
+
+    /* only primes above those already known are sieved */
+    size_t low = sieving->large_limit ? sieving->large_limit : MAX_SIEVING_PRIME;
+    size_t count;
+    uint32_t *primes = sieve_primes_between(low, limit, &count);
+
+    uint32_t *large = (uint32_t*) realloc(sieving->large, (sieving->large_count + count) * sizeof(uint32_t));
+    if (NULL == large) exit(EXIT_FAILURE);
+
+    memcpy(&large[sieving->large_count], primes, count * sizeof(uint32_t));
+    free(primes);
+
+    sieving->large = large;
+    sieving->large_count += count;
+    sieving->large_limit = limit;
+}
+
+
+static void free_sieving_primes(sieving_primes_t *sieving)
+{
+    free(sieving->primes);
+    free(sieving->large);
+    *sieving = (sieving_primes_t){};
+}
+
+
+static int open_cache_file(size_t file_idx)
+{
+    char filename[MAX_FILENAME_SIZE];
+    if (MAX_FILENAME_SIZE < sprintf(filename, "%s.%zu", FILENAME_PREFIX, file_idx))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = open(filename, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+    if (-1 == fd)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    return fd;
+}
+
+
+static void extend_cache_file(size_t file_idx, int fd, size_t size)
+{
+    pthread_mutex_lock(&s_extend_lock);
+
+    size_t *file_size = get_file_size(file_idx, fd);
+    if (*file_size < size)
+    {
+        /* sparse, blocks are allocated by the file system once pages are written */
+        if (-1 == ftruncate(fd, size)) exit(EXIT_FAILURE);
+        *file_size = size;
+        stats_add(STATS_FILE_EXTENSIONS, 1);
+    }
+
+    pthread_mutex_unlock(&s_extend_lock);
+}
+
+
+static void preallocate_cache_range(size_t first_byte, size_t length)
+{
+    while (length)
+    {
+        size_t file_idx = first_byte / FILE_CAPACITY;
+        size_t file_offset = first_byte % FILE_CAPACITY;
+        size_t in_file = FILE_CAPACITY - file_offset;
+        if (in_file > length) in_file = length;
+
+        int fd = open_cache_file(file_idx);
+        pthread_mutex_lock(&s_extend_lock);
+
+        /* unwritten extents read as zeros, which are undefined cells, until workers store them */
+        size_t *file_size = get_file_size(file_idx, fd);
+        if (0 == fallocate(fd, 0, file_offset, in_file))
+        {
+            if (*file_size < file_offset + in_file) *file_size = file_offset + in_file;
+            stats_add(STATS_FILE_PREALLOCATIONS, 1);
+        }
+        /* otherwise workers extend the file sparsely, as on file systems without fallocate */
+
+        pthread_mutex_unlock(&s_extend_lock);
+        close(fd);
+
+        first_byte += in_file;
+        length -= in_file;
+    }
+}
+
+
+static size_t *get_file_size(size_t file_idx, int fd)
+{
+    if (file_idx >= s_file_sizes_count)
+    {
+        size_t count = 2 * file_idx + 1;
+        size_t *sizes = (size_t*) realloc(s_file_sizes, count * sizeof(size_t));
+        if (NULL == sizes) exit(EXIT_FAILURE);
+
+        memset(&sizes[s_file_sizes_count], 0xff, (count - s_file_sizes_count) * sizeof(size_t));
+        s_file_sizes = sizes;
+        s_file_sizes_count = count;
+    }
+
+    if (-1ul == s_file_sizes[file_idx])
+    {
+        struct stat st;
+        if (-1 == fstat(fd, &st)) exit(EXIT_FAILURE);
+        s_file_sizes[file_idx] = st.st_size;
+    }
+
+    return &s_file_sizes[file_idx];
+}
+
+
+static void open_cache(cache_t *cache)
+{
+    change_file(cache, 0);
+
+    /* just created file gets its first page */
+    extend_cache_file(0, cache->fd, s_page_size);
+
+    cache->page_offset = -1ul;
+}
+
+
+static void open_page(cache_t *cache, size_t offset)
+{
+    size_t page_offset = (offset - offset % s_page_size);
+
+    /* already opened */
+    if (cache->page_offset == page_offset) return;
+
+    size_t file_offset = page_offset % FILE_CAPACITY;
+    size_t file_idx = page_offset / FILE_CAPACITY;
+
+    if (cache->file_idx != file_idx)
+    {
+        change_file(cache, file_idx);
+    }
+
+    /* need to extend file */
+    extend_cache_file(file_idx, cache->fd, file_offset + s_page_size);
+    thaw_cache_page(cache, file_offset);
+    note_access(page_offset / (SEGMENT_PAGES * s_page_size));
+
+    char *page = (char*) mmap(NULL,
+        s_page_size,
+        PROT_READ|PROT_WRITE,
+        MAP_SHARED,
+        cache->fd,
+        file_offset
+    );
+
+    if (MAP_FAILED == page)
+    {
+        close(cache->fd);
+        exit(EXIT_FAILURE);
+    }
+
+    if (cache->page) munmap(cache->page, s_page_size);
+    stats_add(STATS_PAGE_REMAPS, 1);
+
+    cache->page = page;
+    cache->page_offset = page_offset;
+}
+
+
+static void change_file(cache_t *cache, size_t file_idx)
+{
+    int fd = open_cache_file(file_idx);
+
+    if (cache->fd)
+    {
+        close(cache->fd);
+    }
+
+    cache->file_idx = file_idx;
+    cache->fd = fd;
+    stats_add(STATS_FILE_SWITCHES, 1);
+}
+
+
+static void close_cache(cache_t *cache)
 {
-    s_page_size = sysconf(_SC_PAGESIZE);
+    close(cache->fd);
+    if (cache->page) munmap(cache->page, s_page_size);
 
-    open_cache(&s_cache);
+    /* descriptor number may be reused by the next `init_cache`, which must not close it */
+    *cache = (cache_t){};
 }
 
 
-void fini_cache(void)
+static bool lookup_cache(cache_t *cache, size_t number)
 {
-    close_cache(&s_cache);
-}
+    bool sparse;
+    if (s_sparse_mode && lookup_sparse(cache, number, &sparse)) return sparse;
 
+    uint64_t started = stats_clock();
 
-bool is_prime_cached(size_t number)
-{
-    if (number == 2) return true;
-    if (number % 2 == 0) return false;
-    switch (check_prime(&s_cache, number))
+    switch (check_prime(cache, number))
     {
         case UNDEFINED: {
+            if (fill_miss_block(cache, number))
+            {
+                stats_add(STATS_CACHE_MISSES, 1);
+                stats_record(STATS_MISS_LATENCY, started);
+                return PRIME == check_prime(cache, number);
+            }
+
+            uint64_t calculation = stats_clock();
             bool prime = is_prime(number);
-            set_prime(&s_cache, number, prime ? PRIME : NOT_PRIME);
+            if (calculation) stats_add(STATS_IS_PRIME_NANOSECONDS, stats_clock() - calculation);
+
+            set_prime(cache, number, prime ? PRIME : NOT_PRIME);
+            stats_add(STATS_CACHE_MISSES, 1);
+            stats_record(STATS_MISS_LATENCY, started);
             return prime;
         }
-        case PRIME:     return true;
-        case NOT_PRIME: return false;
-        default:        exit(EXIT_FAILURE);
+        case PRIME:
+            stats_add(STATS_CACHE_HITS, 1);
+            stats_record(STATS_LOOKUP_LATENCY, started);
+            return true;
+        case NOT_PRIME:
+            stats_add(STATS_CACHE_HITS, 1);
+            stats_record(STATS_LOOKUP_LATENCY, started);
+            return false;
+        default:
+            exit(EXIT_FAILURE);
     }
 }
 
 
-dynarr_t *create_primes_array(void)
+static bool lookup_sparse(cache_t *cache, size_t number, bool *out)
 {
-    dynarr_t *array = dynarr_create(.element_size = sizeof(size_t));
-    return array;
-}
+    size_t page = number / 8 / s_page_size;
 
+    /* mapped page answers cheaper than the store */
+    if (cache->page_offset / s_page_size == page) return false;
 
-void get_primes_range(size_t begin, size_t end, dynarr_t **out)
-{
-    // dynarr_clear(*out);
-    for (; begin <= end; ++begin)
+    uint64_t started = stats_clock();
+
+    const uint8_t *stored = (const uint8_t*) hash_store_find(&s_sparse_store, number);
+    if (stored)
     {
-        if (is_prime_cached(begin))
-        {
-            dynarr_append(out, &begin);
-        }
+        *out = PRIME == *stored;
+        stats_add(STATS_CACHE_HITS, 1);
+        stats_record(STATS_LOOKUP_LATENCY, started);
+        return true;
     }
-}
 
+    const uint32_t *density = (const uint32_t*) hash_store_find(&s_density_store, page + 1);
+    uint32_t results = density ? *density : 0;
+    if (PROMOTED_PAGE == results) return false;
 
-size_t get_lowest_primitive_root(size_t prime)
-{
-    dynarr_t *factors = create_pair_array();
-    find_prime_factors(prime, &factors);
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    if (is_segment_published(number / 8 / segment_bytes * segment_bytes)) return false;
 
-    /* reduce */
-    size_t total_count = 0;
-    for (size_t i = 0; i < dynarr_size(factors); ++i)
+    if (results + 1 >= SPARSE_PROMOTE_RESULTS)
     {
-        total_count += ((pair_t*) dynarr_get(factors, i))->second;
+        /* dense enough, this and later queries of the page are stored to the cache file */
+        uint32_t promoted = PROMOTED_PAGE;
+        hash_store_insert(&s_density_store, page + 1, &promoted);
+        stats_add(STATS_SPARSE_PROMOTIONS, 1);
+        return false;
     }
 
-    size_t unique_count = dynarr_size(factors);
-    size_t lowest_factor = 0; /* zero means no primitive roots */
+    uint64_t calculation = stats_clock();
+    bool prime = is_prime(number);
+    if (calculation) stats_add(STATS_IS_PRIME_NANOSECONDS, stats_clock() - calculation);
 
-    for (size_t k = 0; k < total_count; ++k)
-    {
-        size_t test = k + 2;
-        bool check = true;
-        for (size_t power = 0; check && power < unique_count; ++power)
-        {
-            size_t factor = ((pair_t*) dynarr_get(factors, power))->first;
-            check &= (1 != modpow(test, (prime - 1) / factor, prime));
-        }
-        if (check)
-        {
-            lowest_factor = test;
-            break;
-        }
-    }
+    uint8_t value = prime ? PRIME : NOT_PRIME;
+    hash_store_insert(&s_sparse_store, number, &value);
+
+    ++results;
+    hash_store_insert(&s_density_store, page + 1, &results);
 
-    dynarr_destroy(factors);
-    return lowest_factor;
+    stats_add(STATS_CACHE_MISSES, 1);
+    stats_add(STATS_SPARSE_RESULTS, 1);
+    stats_record(STATS_MISS_LATENCY, started);
+
+    *out = prime;
+    return true;
 }
 
 
-void get_primitive_roots(size_t prime, size_t lowest_root, dynarr_t **out)
+static size_t count_collected_primes(size_t low, size_t high)
 {
-    size_t power = 2;
-
-    dynarr_clear(*out);
-    dynarr_append(out, &lowest_root);
+    size_t count = 0;
 
-    for (; power < prime; ++power)
+    /* collected by chunks so the primes are never held at once */
+    for (;;)
     {
-        if (1 == gcd(power, prime - 1))
-        {
-            size_t root = modpow(lowest_root, power, prime);
-            dynarr_binary_insert(out, &root, cmp_asc, NULL, NULL);
-        }
+        size_t chunk_end = high - low < COUNT_CHUNK_NUMBERS ? high : low + COUNT_CHUNK_NUMBERS - 1;
+
+        dynarr_t *primes = create_primes_array();
+        get_primes_range(low, chunk_end, &primes);
+        count += dynarr_size(primes);
+        dynarr_destroy(primes);
+
+        if (chunk_end == high) break;
+        low = chunk_end + 1;
     }
+
+    return count;
 }
 
 
-size_t get_medium_range_proot(dynarr_t *proots)
+static bool is_segment_published(size_t first_byte)
 {
-    return *(size_t*)dynarr_get(proots, dynarr_size(proots) / 2);
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t file_idx = first_byte / FILE_CAPACITY;
+
+    /* opening states of every touched file would spread sidecars just like the pages */
+    const segment_states_t *states = (const segment_states_t*) find_file_entry(&s_segment_states, file_idx);
+    return states && segment_states_is_complete(states, first_byte % FILE_CAPACITY / segment_bytes);
 }
 
 
-size_t calc_medium_range_proot(size_t prime)
+static bool fill_miss_block(cache_t *cache, size_t number)
 {
-    size_t lowest_root = get_lowest_primitive_root(prime);
-    if (!lowest_root)  return 0; /* zero means no primitive roots */
+    if (MISS_POLICY_NUMBER == s_miss_policy) return false;
 
-    dynarr_t *proots = create_primes_array();
+    if (MISS_POLICY_PAGE == s_miss_policy)
+    {
+        /* page is already mapped by `check_prime` */
+        const sieving_primes_t *sieving = acquire_sieving_primes_for(cache->page_offset * 8 + s_page_size * 8);
+        if (NULL == sieving) return false;
+
+        fill_cache_region(cache->page, cache->page_offset, s_page_size, sieving, NULL, s_block_composite);
+        release_sieving_primes();
+        record_complete_pages(cache->page, cache->page_offset, s_page_size);
+        stats_add(STATS_BLOCK_FILLS, 1);
+        return true;
+    }
 
-    get_primitive_roots(prime, lowest_root, &proots);
+    size_t segment_bytes = SEGMENT_PAGES * s_page_size;
+    size_t first_byte = number / 8 / segment_bytes * segment_bytes;
+    const sieving_primes_t *sieving = acquire_sieving_primes_for(first_byte * 8 + segment_bytes * 8);
+    if (NULL == sieving) return false;
 
-    size_t mid_proot = get_medium_range_proot(proots);
+    size_t file_offset = first_byte % FILE_CAPACITY;
+    extend_cache_file(cache->file_idx, cache->fd, file_offset + segment_bytes);
 
-    dynarr_destroy(proots);
-    return mid_proot;
-}
+    char *region = map_cache_file_region(cache->fd, cache->file_idx, file_offset, segment_bytes);
 
+    fill_cache_region(region, first_byte, segment_bytes, sieving, NULL, s_block_composite);
+    release_sieving_primes();
 
-dynarr_t *create_pair_array(void)
-{
-    dynarr_t *array = dynarr_create(.element_size = sizeof(pair_t));
-    return array;
+    /* whole segment is defined, publish it to reader processes same as the range engine does */
+    segment_states_mark(get_segment_states(cache->file_idx), file_offset / segment_bytes);
+    record_complete_pages(region, first_byte, segment_bytes);
+
+    unmap_cache_region(region, segment_bytes);
+    stats_add(STATS_BLOCK_FILLS, 1);
+    return true;
 }
 
 
-void calc_PMPR_table(size_t begin, size_t end, dynarr_t **out)
+static cache_value_t check_prime(cache_t *cache, size_t number)
 {
-    dynarr_t *primes = create_primes_array();
-    get_primes_range(begin, end, &primes);
+    size_t odd_idx = number / 2;
+    size_t byte_offset = odd_idx / 4;
+    size_t in_page_offset = byte_offset % s_page_size;
+    size_t bit = (odd_idx % 4) * 2;
 
-    size_t size = dynarr_size(primes);
-    for (size_t i = 0; i < size; ++i)
-    {
-        size_t* prime = (size_t*) dynarr_get(primes, i);
-        size_t mid_proot = calc_medium_range_proot(*prime);
+    open_page(cache, byte_offset);
+    return (cache->page[in_page_offset] >> bit) & VALUES_TOTAL;
+}
 
-        if (!mid_proot) continue; /* skip prime with no primitive roots */
 
-        pair_t *pair = &(pair_t){
-            .first = *prime,
-            .second = mid_proot
-        };
+static void set_prime(cache_t *cache, size_t prime, cache_value_t value)
+{
+    size_t odd_idx = prime / 2;
+    size_t byte_offset = odd_idx / 4;
+    size_t in_page_offset = byte_offset % s_page_size;
+    size_t bit = (odd_idx % 4) * 2;
 
-        dynarr_append(out, pair);
-    }
-    dynarr_destroy(primes);
+    open_page(cache, byte_offset);
+    __atomic_fetch_or(&cache->page[in_page_offset], value << bit, __ATOMIC_RELAXED);
 }
 
 
-void gen_PMPR_c_header(size_t begin, size_t end, const char *filename)
+static void open_l1_cache(l1_cache_t *l1, size_t limit)
 {
-    if (filename == NULL) filename = "pmpr.h";
-    assert(MAX_HEADER_NAME_SIZE >= strlen(filename));
+    l1->limit = 0;
+    l1->bits = NULL;
+    if (0 == limit) return;
 
-    dynarr_t *PMPR_table = create_pair_array();
-    calc_PMPR_table(begin, end, &PMPR_table);
-
-    FILE *file = fopen(filename, "w");
+    l1->bits = (uint64_t*) malloc(sieve_odd_bitset_words(limit) * sizeof(uint64_t));
+    if (NULL == l1->bits) exit(EXIT_FAILURE);
 
-    char include_guard[MAX_HEADER_NAME_SIZE + 2];
-    generate_include_guard(filename, include_guard);
+    sieve_odd_bitset(l1->bits, limit);
+    l1->limit = limit;
+}
 
-    dynarr_t *contents = dynarr_create(.element_size = 1);
-    generate_table_contents(PMPR_table, &contents);
 
-    fprintf(file,
-        "#ifndef %s\n"
-        "#define %s\n"
-        "%s\n" /* pair definition */
-        "pair_t pmpr_table[] = {\n"
-        "%s" /* table contents */
-        "};\n"
-        "#endif/*%s*/",
-        include_guard,
-        include_guard,
-        pair_definition,
-        (char*)dynarr_first(contents),
-        include_guard
-        );
-    
-    fclose(file);
-    dynarr_destroy(contents);
-    dynarr_destroy(PMPR_table);
+static void close_l1_cache(l1_cache_t *l1)
+{
+    free(l1->bits);
+    l1->bits = NULL;
+    l1->limit = 0;
 }
 
 
-static ssize_t cmp_asc(const void *value, const void *element, void *param)
+static bool check_l1_prime(const l1_cache_t *l1, size_t number)
 {
-    (void)param;
-    return (ssize_t)*(size_t*)value - *(size_t*)element;
+    size_t odd_idx = number / 2;
+    return (l1->bits[odd_idx / 64] >> (odd_idx % 64)) & 1;
 }
 
 
-static size_t gcd(size_t a, size_t b)
+static void find_prime_factors(size_t prime, factorization_t *out)
 {
-    size_t temp;
-    while (b != 0)
+    size_t number = prime - 1;
+    out->unique = 0;
+    out->total = 0;
+
+    /* nothing to factor, zero would be divisible forever */
+    if (prime < 3) return;
+
+    check_factor(2, &number, out);
+
+    const small_prime_t *small_primes = get_small_primes();
+    for (size_t i = 0; i < SMALL_PRIMES_COUNT; ++i)
     {
-        temp = a % b;
+        const small_prime_t *sp = &small_primes[i];
+        if (sp->prime * sp->prime > number) break;
 
-        a = b;
-        b = temp;
+        check_small_factor(sp, &number, out);
     }
-    return a;
-}
 
+    const uint8_t *increments = get_wheel_increments();
 
-static ssize_t modpow(size_t base, size_t exp, size_t mod)
-{
-    ssize_t product;
-    ssize_t pseq;
-    product = 1;
-    pseq = base % mod;
-    while (exp > 0)
+    for (size_t factor = WHEEL_START, spoke = WHEEL_START_SPOKE;
+         factor <= number / factor;
+         factor += increments[spoke], spoke = (spoke + 1) % WHEEL_SPOKES)
     {
-        if (exp & 1)
+        if (number % factor == 0)
         {
-            product = (product * pseq) % mod;
+            check_factor(factor, &number, out);
         }
-        pseq = (pseq * pseq) % mod;
-        exp >>= 1;
     }
-    return product;
+
+    /* what is left is a prime factor itself */
+    if (number > 1)
+    {
+        check_factor(number, &number, out);
+    }
 }
 
 
-static void open_cache(cache_t *cache)
+static void check_factor(size_t factor, size_t *number, factorization_t *out)
 {
-    change_file(cache, 0);
+    size_t power = 0;
 
-    if (0 == lseek(cache->fd, 0, SEEK_END)) /* just created */
+    while (0 == *number % factor)
     {
-        if (-1 == ftruncate(cache->fd, s_page_size)) exit(EXIT_FAILURE);
+        ++power;
+        *number /= factor;
     }
 
-    cache->page_offset = -1ul;
+    if (power >= 1)
+    {
+        out->primes[out->unique++] = factor;
+        out->total += power;
+    }
 }
 
 
-static void open_page(cache_t *cache, size_t offset)
+static void check_small_factor(const small_prime_t *sp, size_t *number, factorization_t *out)
 {
-    size_t page_offset = (offset - offset % s_page_size);
+    size_t power = 0;
 
-    /* already opened */
-    if (cache->page_offset == page_offset) return;
+    /* exact division is a multiplication by the inverse */
+    while (*number * sp->inverse <= sp->limit)
+    {
+        ++power;
+        *number *= sp->inverse;
+    }
 
-    size_t file_offset = page_offset % FILE_CAPACITY;
-    size_t file_idx = page_offset / FILE_CAPACITY;
+    if (power >= 1)
+    {
+        out->primes[out->unique++] = sp->prime;
+        out->total += power;
+    }
+}
 
-    if (cache->file_idx != file_idx)
+
+static size_t lowest_primitive_root(proot_ctx_t *ctx, size_t prime, const factorization_t *factors)
+{
+    if (prime < 3 || prime % 2 == 0) return 0; /* zero means no primitive roots */
+
+    montgomery_t *mont = &ctx->mont;
+    montgomery_init(mont, prime);
+
+    /*
+    * Exponents are computed once per prime. Factor 2 is not among them:
+    * primitive root is a quadratic non-residue, which Jacobi symbol tells without modpow.
+    */
+    size_t count = 0;
+    for (size_t i = 0; i < factors->unique; ++i)
     {
-        change_file(cache, file_idx);
+        if (factors->primes[i] == 2) continue;
+        ctx->exponents[count++] = (prime - 1) / factors->primes[i];
     }
 
-    /* need to extend file */
-    if ((size_t)lseek(cache->fd, SEEK_END, 0) <= file_offset)
+    /*
+    * Every odd prime has a primitive root, so the search always succeeds.
+    * Candidates are filtered by Jacobi symbol rather than by primality,
+    * the lowest root is not always a prime (6 for 41).
+    */
+    for (size_t test = 2; test < prime; ++test)
     {
-        if (-1 == ftruncate(cache->fd, file_offset + s_page_size))
+        if (-1 != jacobi(test, prime)) continue;
+
+        montgomery_pow_multi(mont, montgomery_to(mont, test), ctx->exponents, count, ctx->powers);
+
+        bool check = true;
+        for (size_t i = 0; check && i < count; ++i)
         {
-            exit(EXIT_FAILURE);
+            check = (mont->one != ctx->powers[i]);
         }
+        if (check) return test;
     }
 
-    char *page = (char*) mmap(NULL,
-        s_page_size,
-        PROT_READ|PROT_WRITE,
-        MAP_SHARED,
-        cache->fd,
-        file_offset
-    );
+    return 0;
+}
 
-    if (MAP_FAILED == page)
-    {
-        close(cache->fd);
-        exit(EXIT_FAILURE);
-    }
 
-    if (cache->page) munmap(cache->page, s_page_size);
+static size_t medium_range_proot(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    const factorization_t *factors)
+{
+    size_t count = collect_primitive_roots(ctx, prime, lowest_root, factors);
 
-    cache->page = page;
-    cache->page_offset = page_offset;
+    return select_primitive_root(ctx, count / 2);
 }
 
 
-static void change_file(cache_t *cache, size_t file_idx)
+static void walk_roots(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    const factorization_t *factors, proot_visit_t visit, void *param)
 {
-    char filename[MAX_FILENAME_SIZE];
-    if (MAX_FILENAME_SIZE < sprintf(filename, "%s.%zu", FILENAME_PREFIX, file_idx))
-    {
-        exit(EXIT_FAILURE);
-    }
+    montgomery_t *mont = &ctx->mont;
+    montgomery_init(mont, prime);
 
-    int fd = open(filename, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
-    if (-1 == fd)
+    /* (prime - 1) is even, so only odd exponents k = 2 * j + 1 can be coprime to it */
+    uint64_t step = montgomery_to(mont, lowest_root);
+    uint64_t power = step;
+    step = montgomery_mul(mont, step, step);
+
+    size_t odd_exponents = (prime - 1) / 2;
+    for (size_t low = 0; low < odd_exponents; low += PROOT_WALK_BLOCK)
     {
-        exit(EXIT_FAILURE);
+        size_t count = odd_exponents - low < PROOT_WALK_BLOCK ? odd_exponents - low : PROOT_WALK_BLOCK;
+        sieve_odd_coprime(ctx->coprime, low, count, factors);
+
+        for (size_t j = 0; j < count; ++j, power = montgomery_mul(mont, power, step))
+        {
+            if (!((ctx->coprime[j / 64] >> (j % 64)) & 1)) continue;
+
+            if (!visit(montgomery_from(mont, power), param)) return;
+        }
     }
+}
 
-    if (cache->fd)
+
+static size_t collect_primitive_roots(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    const factorization_t *factors)
+{
+    reserve_roots(ctx, prime);
+    memset(ctx->roots, 0, (prime / 64 + 1) * sizeof(uint64_t));
+
+    size_t count = 0;
+    walk_roots(ctx, prime, lowest_root, factors, mark_root, ctx);
+
+    for (size_t w = 0; w * 64 < prime; ++w)
     {
-        close(cache->fd);
+        count += __builtin_popcountl(ctx->roots[w]);
     }
 
-    cache->file_idx = file_idx;
-    cache->fd = fd;
+    return count;
 }
 
 
-static void close_cache(cache_t *cache)
+static bool mark_root(size_t root, void *param)
 {
-    close(cache->fd);
-    if (cache->page) munmap(cache->page, s_page_size);
+    proot_ctx_t *ctx = (proot_ctx_t*) param;
+    ctx->roots[root / 64] |= 1ul << (root % 64);
+    return true;
 }
 
 
-static cache_value_t check_prime(cache_t *cache, size_t number)
+static size_t select_primitive_root(const proot_ctx_t *ctx, size_t rank)
 {
-    size_t odd_idx = number / 2;
-    size_t byte_offset = odd_idx / 4;
-    size_t in_page_offset = byte_offset % s_page_size;
-    size_t bit = (odd_idx % 4) * 2;
+    for (size_t w = 0; ; ++w)
+    {
+        uint64_t word = ctx->roots[w];
+        size_t popcount = __builtin_popcountl(word);
 
-    open_page(cache, byte_offset);
-    return (cache->page[in_page_offset] >> bit) & VALUES_TOTAL;
+        if (rank >= popcount)
+        {
+            rank -= popcount;
+            continue;
+        }
+
+        for (; rank; --rank) word &= word - 1;
+        return w * 64 + __builtin_ctzl(word);
+    }
 }
 
 
-static void set_prime(cache_t *cache, size_t prime, cache_value_t value)
+static void reserve_roots(proot_ctx_t *ctx, size_t prime)
 {
-    size_t odd_idx = prime / 2;
-    size_t byte_offset = odd_idx / 4;
-    size_t in_page_offset = byte_offset % s_page_size;
-    size_t bit = (odd_idx % 4) * 2;
+    if (prime < ctx->roots_capacity) return;
 
-    open_page(cache, byte_offset);
-    cache->page[in_page_offset] |= (value << bit);
+    size_t words = prime / 64 + 1;
+    uint64_t *roots = (uint64_t*) realloc(ctx->roots, words * sizeof(uint64_t));
+    if (NULL == roots) exit(EXIT_FAILURE);
+
+    ctx->roots = roots;
+    ctx->roots_capacity = words * 64;
 }
 
 
-static void find_prime_factors(size_t prime, dynarr_t **out)
+static bool find_memoized_proots(size_t prime, proot_entry_t *out)
 {
-    size_t number = prime - 1;
-    dynarr_clear(*out);
+    if (NULL == s_proot_store.map) return false; /* cache is not initialized */
 
-    while (number > 1)
-    {
-        for (size_t factor = 2; factor <= 3; ++factor)
-        {
-            check_factor(factor, &number, out);
-        }
-
-        for (size_t k = 0, p = 4; p < number; ++k, p = 6 * k)
-        {
-            if (number % (p + 1) == 0)
-            {
-                check_factor(p + 1, &number, out);
-            }
+    const proot_entry_t *entry = hash_store_find(&s_proot_store, prime);
+    if (NULL == entry) return false;
 
-            if (number % (p + 5) == 0)
-            {
-                check_factor(p + 5, &number, out);
-            }
-        }
-    }
+    *out = *entry;
+    return true;
 }
 
 
-static void check_factor(size_t factor, size_t *number, dynarr_t **out)
+static void memoize_proots(size_t prime, const proot_entry_t *entry)
 {
-    size_t power = 0;
-
-    while (0 == *number % factor)
-    {
-        ++power;
-        *number /= factor;
-    }
+    if (NULL == s_proot_store.map) return;
 
-    if (power >= 1)
-    {
-        pair_t *prime_factor = &(pair_t){
-            .first = factor,
-            .second = power
-        };
-        dynarr_append(out, prime_factor);
-    }
+    hash_store_insert(&s_proot_store, prime, entry);
 }
 
 
@@ -2,8 +2,11 @@
 #define _PRIMES_H_
 
 #include "dynarr.h"
+#include "mem_budget.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #define REFLECT(name, code) \
     __attribute__((weak)) const char* name = #code; \
@@ -14,6 +17,15 @@
 */
 #define MAX_FILE_SIZE 2199023255552
 
+/*
+* Upper bound (exclusive) of the in-RAM primality bitset that is consulted
+* before the file cache. Takes (L1_CACHE_LIMIT / 16) bytes of memory,
+* e.g. 2^32 requires 256 MiB. Zero disables the bitset.
+*/
+#ifndef L1_CACHE_LIMIT
+#define L1_CACHE_LIMIT (1ul << 28)
+#endif
+
 /*
 * Cache control struct, maps single file block at a time.
 * Utilizes sparce file storage, where a file can grow up to fs limit measured in TiB,
@@ -28,6 +40,18 @@ typedef struct cache
 }
 cache_t;
 
+/*
+* Read-only in-RAM bitset of primerility for every odd number below `limit`,
+* built by a sieve at cache initialization.
+* Bit `i` is set when `2 * i + 1` is a prime.
+*/
+typedef struct l1_cache
+{
+    size_t    limit;
+    uint64_t  *bits;
+}
+l1_cache_t;
+
 /*
 * Each odd number in the cache takes 2 bits of storage.
 * Which means that each cache page stores primerility for (3 * page_size) odd numbers.
@@ -42,6 +66,28 @@ typedef enum cache_value
 cache_value_t;
 
 
+/*
+* What is calculated when a number is not found in the cache.
+*/
+typedef enum miss_policy
+{
+    MISS_POLICY_NUMBER,   /* only the number itself, by trial division */
+    MISS_POLICY_PAGE,     /* every cell of the cache page holding it, by a sieve */
+    MISS_POLICY_SEGMENT   /* every cell of the aligned block of pages used by the range engine */
+}
+miss_policy_t;
+
+/*
+* Primitive roots of a prime memoized in the roots store alongside the cache.
+*/
+typedef struct proot_entry
+{
+    size_t lowest;
+    size_t medium;
+}
+proot_entry_t;
+
+
 REFLECT(pair_definition,
     typedef struct pair
     {
@@ -68,6 +114,12 @@ void fini_cache(void);
 */
 bool is_prime_cached(size_t number);
 
+/*
+* Batch version of `is_prime_cached`, primerility of each of `count` numbers stored in `out`.
+* Candidates are pre-screened by small primes several at a time before the cache lookup.
+*/
+void are_primes_cached(const size_t *numbers, size_t count, bool *out);
+
 /*
 * Factory function for vector that stores primes.
 */
@@ -76,14 +128,229 @@ dynarr_t *create_primes_array(void);
 /*
 * Function checks range of numbers from `begin` to `end` inclusive for primerility.
 * Result stored in a vector `out` that has to be created prior this call.
+* Ranges above 2^52 are sieved by primes up to their square root, the ones above 2^26
+* are generated once (up to 800 MiB near 2^64) and kept for later calls along with
+* their buckets where the range stopped (up to 1.6 GiB), so the next range resumes them.
 */
 void get_primes_range(size_t begin, size_t end, dynarr_t **out);
 
+/*
+* Amount of primes within [begin, end] inclusive. Pages of the cache recorded as complete
+* in the page directory (`primes.dat.N.pages`) are counted by their stored amounts without
+* touching their cells, the rest is collected by `get_primes_range` (which records them).
+*/
+size_t count_primes_range(size_t begin, size_t end);
+
+/*
+* Same as `get_primes_range`, but the range is split into page-aligned segments of the cache
+* that are sieved and stored by `threads` workers (zero means one per online cpu).
+* Primes are appended to `out` in ascending order.
+* `get_primes_range` switches to it by itself for wide ranges.
+* It may run from several threads at once, sieving primes are shared under a lock;
+* the other calls still expect one calling thread.
+*/
+void get_primes_range_parallel(size_t begin, size_t end, size_t threads, dynarr_t **out);
+
+/*
+* Sets how much of the cache is calculated on a miss of `is_prime_cached` and `are_primes_cached`,
+* MISS_POLICY_PAGE by default. Neighbouring queries are then answered from the cache,
+* at the price of a sieve by primes up to square root of the block on each miss.
+* Numbers whose square root exceeds the sieving primes limit (2^26) are always
+* calculated one by one.
+*/
+void set_miss_policy(miss_policy_t policy);
+
+/*
+* Enables hybrid storage of point lookups, disabled by default.
+* Results of isolated queries are kept in a persistent hash table (`primes.sparse`,
+* 16 bytes per result) instead of a page of `primes.dat.N` per result.
+* Once a page gathers enough results it is promoted and its later queries
+* go to the cache file as usual, pages published by the range engine are used right away.
+*/
+void set_sparse_mode(bool enabled);
+
+/*
+* Enables access pattern detection of the cache, disabled by default.
+* Once lookups or ranges move through the cache sequentially or with a constant stride,
+* a background worker prefetches segments ahead of them from disk
+* and sieves their undefined cells, so the stream does not stall on cold pages.
+*/
+void set_read_ahead(bool enabled);
+
+/*
+* Limits bytes mapped by segments of the cache files to `bytes` (zero, the default,
+* means no limit), mapped bytes bound resident ones from above. Segments sieved or scanned by the range engine, the read-ahead worker
+* and segment-sized misses stay mapped for reuse, the least recently used ones are shed
+* once the limit is reached (MADV_COLD first, then written back, paged out and unmapped).
+*/
+void set_cache_memory_budget(size_t bytes);
+
+/*
+* Current usage of the memory budget, resident bytes are queried by mincore.
+*/
+void get_cache_memory_usage(mem_usage_t *out);
+
+/*
+* Largest prime below 2^64.
+*/
+#define LARGEST_PRIME 18446744073709551557ul
+
+/*
+* Smallest prime greater than `number`, zero if it does not fit into size_t.
+* Scans defined cells of the cache a word (32 odd numbers) at a time, undefined ones
+* are sieved in a window of a few expected prime gaps (at most a page) and stored to the cache.
+*/
+size_t next_prime(size_t number);
+
+/*
+* Largest prime less than `number`, zero if there is none.
+*/
+size_t prev_prime(size_t number);
+
+/*
+* Same as `next_prime`/`prev_prime` applied `k` times.
+*/
+size_t next_prime_k(size_t number, size_t k);
+size_t prev_prime_k(size_t number, size_t k);
+
+/*
+* Enables NUMA-aware execution of range jobs: segments of the cache are split into contiguous
+* runs, one per node, each processed by workers pinned to that node, so mapped pages
+* of `primes.dat.N` not in the page cache yet are first touched (and so allocated) on the node
+* working on them. Amount of workers of all nodes is at most `threads` of the job.
+* Resets per-node statistics.
+*/
+void set_numa_mode(bool enabled);
+
+/*
+* Prints per-node throughput of range jobs executed since NUMA mode was enabled.
+*/
+void print_numa_report(FILE *file);
+
+/*
+* Moves complete segments of the cache which intersect [begin, end] to the compressed
+* cold tier (`primes.dat.N.cold`) and punches them out of the cache files.
+* Frozen segments are restored transparently once they are accessed again.
+* Segments mapped by open views or workers of this process are skipped.
+* Must not run while reader processes (`cache_reader_t`) scan the range.
+* Returns amount of frozen segments.
+*/
+size_t freeze_cache_range(size_t begin, size_t end);
+
+/*
+* Read-only view of the cache for consumer processes, which map cache files
+* of the working directory read-only and never compute anything themselves.
+* Only segments published as complete by the range engine of a writer process
+* (`get_primes_range`, `get_primes_range_parallel`, the daemon) are answered,
+* these are scanned directly from the shared mapping, without locks. Mappings follow
+* sizes of the files, only segments past the mapped size cost a syscall to grow it.
+*/
+typedef struct cache_reader cache_reader_t;
+
+cache_reader_t *cache_reader_open(void);
+void cache_reader_close(cache_reader_t *reader);
+
+/*
+* Appends primes of [begin, end] to `out` up to the first segment not complete yet,
+* returns first number which is not answered (end + 1 when the whole range is),
+* the rest has to be requested from the writer.
+*/
+size_t cache_reader_get_primes_range(cache_reader_t *reader, size_t begin, size_t end, dynarr_t **out);
+
+/*
+* Stores primality of the `number` into `out` and returns true if it is known to the reader.
+*/
+bool cache_reader_check_prime(cache_reader_t *reader, size_t number, bool *out);
+
+/*
+* Zero-copy view of [begin, end] of the cache. The range is calculated first,
+* then cells of its pages are mapped read-only and handed out as they are,
+* a span per cache file covering whole pages (cells around the range included):
+* 32 odd numbers per word, cell `i` of word `w` holds `first_number + 2 * (32 * w + i)`,
+* a prime has its cell set to PRIME (01), so `w & ~(w >> 1) & 0x5555555555555555`
+* leaves one bit per prime. Rank and select use prime counts of the page directory.
+*/
+typedef struct prime_span
+{
+    const uint64_t *words;
+    size_t    words_count;
+    size_t    first_number; /* odd number of the lowest cell of words[0] */
+}
+prime_span_t;
+
+typedef struct prime_view prime_view_t;
+
+prime_view_t *prime_view_open(size_t begin, size_t end);
+void prime_view_close(prime_view_t *view);
+
+/*
+* Stores spans of the `view` into `out`, returns their amount. Number 2 is not in any span.
+*/
+size_t prime_view_spans(const prime_view_t *view, const prime_span_t **out);
+
+bool prime_view_test(const prime_view_t *view, size_t number);
+
+/*
+* Amount of primes of the view not greater than `number`.
+*/
+size_t prime_view_rank(const prime_view_t *view, size_t number);
+
+/*
+* Prime of the view with zero based `rank` in ascending order, zero if there is none.
+*/
+size_t prime_view_select(const prime_view_t *view, size_t rank);
+size_t prime_view_count(const prime_view_t *view);
+
+/*
+* Callback receiving matches of a pattern search one by one in ascending order,
+* `prime` is the first prime of the match and `width` the distance to its last one.
+* Returns false to stop the search.
+*/
+typedef bool (*prime_match_visit_t)(size_t prime, size_t width, void *param);
+
+/*
+* Streams every k-tuple of primes within [begin, end]: primes `p` such that each
+* `p + offsets[i]` is a prime, e.g. {0, 2} for twins, {0, 2, 6, 8} for quadruplets.
+* Offsets are ascending even numbers starting from zero, otherwise nothing matches.
+* The range is calculated first, then its prime masks are shifted and ANDed a word
+* (32 odd numbers) at a time, so no list of primes is built. Returns amount of matches.
+*/
+size_t find_prime_tuples(size_t begin, size_t end, const size_t *offsets, size_t count,
+    prime_match_visit_t visit, void *param);
+
+/*
+* Streams consecutive primes of [begin, end] which are at least `min_gap` apart.
+* Gaps of 64 and wider are found by the lowest and highest prime of each word only.
+* Returns amount of matches.
+*/
+size_t find_prime_gaps(size_t begin, size_t end, size_t min_gap,
+    prime_match_visit_t visit, void *param);
+
+/*
+* Prints statistics of the cache (hits, misses, remaps, file extensions, ...)
+* and latency histograms when enabled by `set_stats_timing`, see stats.h.
+*/
+void print_cache_stats(FILE *file);
+void reset_cache_stats(void);
+void set_stats_timing(bool enabled);
+
+/*
+* Scratch context of primitive root calculations.
+* Owns all buffers they require (factors, roots bitmap, montgomery context),
+* so repeated `*_ctx` calls with the same context do not allocate memory.
+* Created for primes up to `max_prime`, grows on demand.
+*/
+typedef struct proot_ctx proot_ctx_t;
+
+proot_ctx_t *proot_ctx_create(size_t max_prime);
+void proot_ctx_destroy(proot_ctx_t *ctx);
+
 /*
 * Function calculates and returns lowest primitive root of a `prime` number.
 * If prime has no primitive roots, zero value will be returned.
 */
 size_t get_lowest_primitive_root(size_t prime);
+size_t get_lowest_primitive_root_ctx(proot_ctx_t *ctx, size_t prime);
 
 /*
 * Function calculates and returns all primitive roots of the `prime`,
@@ -92,6 +359,19 @@ size_t get_lowest_primitive_root(size_t prime);
 */
 void get_primitive_roots(size_t prime, size_t lowest_root, dynarr_t **out);
 
+/*
+* Callback receiving primitive roots one by one, returns false to stop the walk.
+*/
+typedef bool (*proot_visit_t)(size_t root, void *param);
+
+/*
+* Streams all primitive roots of the `prime` into `visit` callback, given its lowest root.
+* Roots come in order of exponents of the lowest root (not sorted), each one costs
+* a single modular multiplication, exponents coprime to (prime - 1) are sieved.
+*/
+void walk_primitive_roots(proot_ctx_t *ctx, size_t prime, size_t lowest_root,
+    proot_visit_t visit, void *param);
+
 /*
 * Returns middle element from vector of primitive roots.
 */
@@ -103,6 +383,7 @@ size_t get_medium_range_proot(dynarr_t *proots);
 * If prime has no primitive roots, zero value will be returned.
 */
 size_t calc_medium_range_proot(size_t prime);
+size_t calc_medium_range_proot_ctx(proot_ctx_t *ctx, size_t prime);
 
 /*
 * Factory function that creates vector of size_t pairs.
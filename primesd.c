@@ -0,0 +1,37 @@
+#include "primes.h"
+#include "server.h"
+#include "protocol.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void handle_signal(int signal);
+
+
+int main(int argc, char **argv)
+{
+    const char *socket_path = argc > 1 ? argv[1] : PROTO_DEFAULT_SOCKET;
+
+    struct sigaction action = { .sa_handler = handle_signal };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    init_cache();
+
+    /* clients tend to scan ranges, the daemon keeps ahead of them */
+    set_read_ahead(true);
+    server_run(socket_path);
+    fini_cache();
+
+    return EXIT_SUCCESS;
+}
+
+
+static void handle_signal(int signal)
+{
+    (void) signal;
+    server_stop();
+}
@@ -0,0 +1,69 @@
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+#include <stdint.h>
+
+/*
+* Binary protocol of the primes daemon over a Unix stream socket.
+*
+* Every message is a fixed size header followed by `count` payload items,
+* all fields in host byte order (both ends live on the same host).
+* Clients may pipeline any amount of requests, responses come back in request order
+* and carry the `tag` of their request.
+*
+*   request                           payload              response payload
+*   PROTO_IS_PRIME   count numbers    uint64_t[count]      uint8_t[count], 1 for primes
+*   PROTO_RANGE      count = 2        uint64_t begin, end  uint64_t[count] primes
+*   PROTO_COUNT      count = 2        uint64_t begin, end  uint64_t amount of primes
+*   PROTO_PMPR       count = 2        uint64_t begin, end  uint64_t[2 * count] prime, root pairs
+*/
+#define PROTO_DEFAULT_SOCKET "primes.sock"
+
+/*
+* Limits of a single request (items of a batch, span of a range), larger ones
+* have to be split by the client. Payload of any request is at most PROTO_MAX_BATCH items.
+*/
+#define PROTO_MAX_BATCH (1u << 16)
+#define PROTO_MAX_RANGE (1ul << 28)
+#define PROTO_MAX_COUNT_RANGE (1ul << 36)
+#define PROTO_MAX_PMPR_RANGE (1ul << 24)
+
+typedef enum proto_op
+{
+    PROTO_IS_PRIME = 1,
+    PROTO_RANGE,
+    PROTO_COUNT,
+    PROTO_PMPR
+}
+proto_op_t;
+
+typedef enum proto_status
+{
+    PROTO_OK = 0,
+    PROTO_BAD_OP,       /* unknown operation, connection is closed afterwards */
+    PROTO_BAD_ARGS,     /* wrong count or begin > end */
+    PROTO_TOO_LARGE     /* request exceeds one of the limits above */
+}
+proto_status_t;
+
+typedef struct proto_request
+{
+    uint8_t   op;
+    uint8_t   reserved[3];
+    uint32_t  tag;
+    uint64_t  count;    /* amount of uint64_t payload items */
+}
+proto_request_t;
+
+typedef struct proto_response
+{
+    uint8_t   op;
+    uint8_t   status;
+    uint8_t   reserved[2];
+    uint32_t  tag;
+    uint64_t  count;    /* amount of result items, see table above for their size */
+}
+proto_response_t;
+
+
+#endif/*_PROTOCOL_H_*/
@@ -0,0 +1,48 @@
+#include "segment_state.h"
+
+#define SEGMENT_STATE_MAGIC 0x31545344534d5250ul /* "PRMSDST1" */
+
+
+bool segment_states_open(segment_states_t *states, const char *filename,
+    size_t segment_bytes, size_t segments, bool writable)
+{
+    /* epoch of a created file starts at zero */
+    if (!sidecar_open(&states->sidecar, filename, SEGMENT_STATE_MAGIC, segment_bytes, segments,
+        sizeof(uint32_t), writable))
+    {
+        return false;
+    }
+
+    states->header = (segment_state_header_t*) states->sidecar.map;
+    states->epochs = (uint32_t*) (states->sidecar.map + SIDECAR_HEADER_SIZE);
+    return true;
+}
+
+
+void segment_states_close(segment_states_t *states)
+{
+    sidecar_close(&states->sidecar);
+    states->header = NULL;
+    states->epochs = NULL;
+}
+
+
+void segment_states_mark(segment_states_t *states, size_t segment)
+{
+    if (segment_states_is_complete(states, segment)) return;
+
+    uint64_t epoch = __atomic_add_fetch(&states->header->epoch, 1, __ATOMIC_ACQ_REL);
+
+    /* zero means incomplete, wrapped epochs skip it */
+    uint32_t value = (uint32_t) epoch ? (uint32_t) epoch : 1;
+    __atomic_store_n(&states->epochs[segment], value, __ATOMIC_RELEASE);
+}
+
+
+void segment_states_clear(segment_states_t *states, size_t segment)
+{
+    __atomic_store_n(&states->epochs[segment], 0, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&states->header->epoch, 1, __ATOMIC_ACQ_REL);
+
+    sidecar_sync(&states->epochs[segment], sizeof(uint32_t));
+}
@@ -0,0 +1,67 @@
+#ifndef _SEGMENT_STATE_H_
+#define _SEGMENT_STATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sidecar.h"
+
+/*
+* Completion states of cache segments shared between processes.
+* Sidecar file `primes.dat.N.state` of each cache file is mapped by the writer read-write
+* and by readers read-only, it holds a header and an epoch per segment:
+* zero while the segment may have undefined cells, otherwise the value of the header epoch
+* at the moment it became complete. Cells of the cache never change once defined,
+* so a complete segment stays complete and readers may scan it without any locking.
+*/
+typedef struct segment_state_header
+{
+    sidecar_header_t sidecar; /* unit is the segment size */
+    uint64_t  epoch;          /* incremented on every completed segment */
+}
+segment_state_header_t;
+
+typedef struct segment_states
+{
+    sidecar_t sidecar;
+    segment_state_header_t *header;
+    uint32_t  *epochs;
+}
+segment_states_t;
+
+/*
+* Maps (and when `writable` creates) state file `filename` for `segments` of `segment_bytes`.
+* Returns false if a reader opens a file which does not exist yet.
+*/
+bool segment_states_open(segment_states_t *states, const char *filename,
+    size_t segment_bytes, size_t segments, bool writable);
+void segment_states_close(segment_states_t *states);
+
+/*
+* Publishes the `segment` as complete, its cells have to be stored before.
+*/
+void segment_states_mark(segment_states_t *states, size_t segment);
+
+/*
+* Withdraws the `segment` from readers, e.g. before it is moved to the cold tier.
+* The state is written to the file before return, readers already scanning it are not waited for.
+*/
+void segment_states_clear(segment_states_t *states, size_t segment);
+
+static inline bool segment_states_is_complete(const segment_states_t *states, size_t segment)
+{
+    /* pairs with the release store of the writer, cells are visible once the epoch is */
+    return 0 != __atomic_load_n(&states->epochs[segment], __ATOMIC_ACQUIRE);
+}
+
+/*
+* Epoch of the writer, changes whenever another segment is completed.
+*/
+static inline uint64_t segment_states_epoch(const segment_states_t *states)
+{
+    return __atomic_load_n(&states->header->epoch, __ATOMIC_ACQUIRE);
+}
+
+
+#endif/*_SEGMENT_STATE_H_*/
@@ -0,0 +1,509 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include "protocol.h"
+#include "primes.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_CLIENTS 256
+#define READ_CHUNK_SIZE 65536
+
+/*
+* Requests of a client are not parsed while that much of its responses is pending,
+* the client has to read them first.
+*/
+#define MAX_PENDING_OUTPUT (64ul << 20)
+
+/*
+* Range operations are answered a slice at a time, one slice per client and round
+* of the poll loop, so a large request does not hold up the other clients.
+*/
+#define RANGE_SLICE (1ul << 24)
+
+/*
+* Every root of a prime is walked to find the middle one, so slices of PMPR
+* are shortened in proportion to their numbers: a slice walks about that many roots.
+*/
+#define PMPR_SLICE_WORK (1ul << 32)
+
+/*
+* Growable byte buffer, data lives in [begin, end) of `data`.
+*/
+typedef struct buffer
+{
+    char      *data;
+    size_t    begin;
+    size_t    end;
+    size_t    capacity;
+}
+buffer_t;
+
+/*
+* Range operation being answered by slices, its results are buffered
+* until the last slice, then the response is appended to the output at once.
+*/
+typedef struct sliced_request
+{
+    proto_request_t request;
+    size_t    next;         /* first number of the next slice */
+    size_t    end;
+    uint64_t  count;        /* amount of results so far */
+    buffer_t  results;
+    bool      active;
+}
+sliced_request_t;
+
+typedef struct connection
+{
+    int       fd;
+    buffer_t  in;
+    buffer_t  out;
+    sliced_request_t sliced;    /* following requests wait until it is answered */
+    bool      closing;  /* protocol error, close once responses are flushed */
+}
+connection_t;
+
+static int open_socket(const char *socket_path);
+static void accept_client(int listen_fd);
+static void close_client(connection_t *client);
+
+/*
+* Reads available data of the `client` and answers its complete requests.
+* Returns false once the connection has to be closed.
+*/
+static bool read_client(connection_t *client);
+static bool write_client(connection_t *client);
+static void process_requests(connection_t *client);
+
+/*
+* Answers single request, returns false on a protocol error.
+* Range operations are only started, see `answer_slice`.
+*/
+static bool handle_request(connection_t *client, const proto_request_t *request, const uint64_t *payload);
+static void answer_is_prime(connection_t *client, const proto_request_t *request, const uint64_t *numbers);
+static void answer_status(connection_t *client, const proto_request_t *request, proto_status_t status);
+
+/*
+* Answers next slice of the range operation of the `client`, once it is the last one
+* appends the response and goes on with the following requests.
+*/
+static void answer_slice(connection_t *client);
+static bool has_slice(const connection_t *client);
+static void slice_range(sliced_request_t *sliced, size_t begin, size_t end);
+static void slice_count(sliced_request_t *sliced, size_t begin, size_t end);
+static void slice_pmpr(sliced_request_t *sliced, size_t begin, size_t end);
+
+static void buffer_reserve(buffer_t *buffer, size_t size);
+static void buffer_append(buffer_t *buffer, const void *data, size_t size);
+static size_t buffer_size(const buffer_t *buffer);
+static void buffer_free(buffer_t *buffer);
+
+static volatile sig_atomic_t s_running;
+static connection_t s_clients[MAX_CLIENTS];
+static size_t s_clients_count;
+
+
+void server_run(const char *socket_path)
+{
+    int listen_fd = open_socket(socket_path);
+    struct pollfd fds[MAX_CLIENTS + 1];
+
+    /* stopped by a signal handler or, in checks, by another thread */
+    __atomic_store_n(&s_running, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&s_running, __ATOMIC_RELAXED))
+    {
+        /* clients with slices to answer do not let the poll wait */
+        bool slicing = false;
+
+        fds[0] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        for (size_t i = 0; i < s_clients_count; ++i)
+        {
+            connection_t *client = &s_clients[i];
+            fds[i + 1].fd = client->fd;
+            fds[i + 1].events = buffer_size(&client->out) ? POLLOUT : 0;
+            if (!client->closing && buffer_size(&client->out) < MAX_PENDING_OUTPUT)
+            {
+                fds[i + 1].events |= POLLIN;
+            }
+            if (has_slice(client)) slicing = true;
+        }
+
+        size_t polled = s_clients_count;
+        if (-1 == poll(fds, polled + 1, slicing ? 0 : -1))
+        {
+            if (EINTR == errno) continue;
+            exit(EXIT_FAILURE);
+        }
+
+        /* walk backwards, closed clients are replaced by the last one */
+        for (size_t i = polled; i > 0; --i)
+        {
+            connection_t *client = &s_clients[i - 1];
+            bool alive = true;
+
+            if (fds[i].revents & (POLLERR|POLLNVAL)) alive = false;
+            if (alive && (fds[i].revents & (POLLIN|POLLHUP))) alive = read_client(client);
+            if (alive && has_slice(client)) answer_slice(client);
+            if (alive && buffer_size(&client->out)) alive = write_client(client);
+            if (alive && client->closing && 0 == buffer_size(&client->out)) alive = false;
+
+            if (!alive) close_client(client);
+        }
+
+        if (fds[0].revents & POLLIN) accept_client(listen_fd);
+    }
+
+    while (s_clients_count) close_client(&s_clients[0]);
+
+    close(listen_fd);
+    unlink(socket_path);
+}
+
+
+void server_stop(void)
+{
+    __atomic_store_n(&s_running, 0, __ATOMIC_RELAXED);
+}
+
+
+static int open_socket(const char *socket_path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) exit(EXIT_FAILURE);
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+    if (-1 == fd) exit(EXIT_FAILURE);
+
+    /* stale socket of a previous run */
+    unlink(socket_path);
+
+    if (-1 == bind(fd, (struct sockaddr*) &addr, sizeof(addr)) || -1 == listen(fd, SOMAXCONN))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    /* broken clients must not kill the daemon */
+    signal(SIGPIPE, SIG_IGN);
+    return fd;
+}
+
+
+static void accept_client(int listen_fd)
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+    if (-1 == fd) return;
+
+    if (MAX_CLIENTS == s_clients_count)
+    {
+        close(fd);
+        return;
+    }
+
+    s_clients[s_clients_count++] = (connection_t){ .fd = fd };
+}
+
+
+static void close_client(connection_t *client)
+{
+    close(client->fd);
+    buffer_free(&client->in);
+    buffer_free(&client->out);
+    buffer_free(&client->sliced.results);
+
+    *client = s_clients[--s_clients_count];
+}
+
+
+static bool read_client(connection_t *client)
+{
+    buffer_reserve(&client->in, READ_CHUNK_SIZE);
+
+    ssize_t size = read(client->fd, client->in.data + client->in.end, READ_CHUNK_SIZE);
+    if (0 == size) return false;
+    if (-1 == size) return EAGAIN == errno || EINTR == errno;
+
+    client->in.end += size;
+    process_requests(client);
+    return true;
+}
+
+
+static bool write_client(connection_t *client)
+{
+    ssize_t size = write(client->fd, client->out.data + client->out.begin, buffer_size(&client->out));
+    if (-1 == size) return EAGAIN == errno || EINTR == errno;
+
+    client->out.begin += size;
+    if (client->out.begin == client->out.end)
+    {
+        client->out.begin = client->out.end = 0;
+    }
+
+    /* parsing could stop because of too much pending output */
+    if (!client->closing && buffer_size(&client->out) < MAX_PENDING_OUTPUT)
+    {
+        process_requests(client);
+    }
+
+    return true;
+}
+
+
+static void process_requests(connection_t *client)
+{
+    buffer_t *in = &client->in;
+
+    while (!client->closing && !client->sliced.active && buffer_size(in) >= sizeof(proto_request_t)
+        && buffer_size(&client->out) < MAX_PENDING_OUTPUT)
+    {
+        proto_request_t request;
+        memcpy(&request, in->data + in->begin, sizeof(request));
+
+        if (request.count > PROTO_MAX_BATCH)
+        {
+            /* payload boundary can not be trusted any more */
+            answer_status(client, &request, PROTO_TOO_LARGE);
+            client->closing = true;
+            break;
+        }
+
+        size_t size = sizeof(request) + request.count * sizeof(uint64_t);
+        if (buffer_size(in) < size) break;
+
+        if (!handle_request(client, &request, (const uint64_t*) (in->data + in->begin + sizeof(request))))
+        {
+            client->closing = true;
+        }
+
+        in->begin += size;
+    }
+
+    /* move incomplete request to the front */
+    memmove(in->data, in->data + in->begin, buffer_size(in));
+    in->end -= in->begin;
+    in->begin = 0;
+}
+
+
+static bool handle_request(connection_t *client, const proto_request_t *request, const uint64_t *payload)
+{
+    if (PROTO_IS_PRIME == request->op)
+    {
+        answer_is_prime(client, request, payload);
+        return true;
+    }
+
+    if (PROTO_RANGE != request->op && PROTO_COUNT != request->op && PROTO_PMPR != request->op)
+    {
+        answer_status(client, request, PROTO_BAD_OP);
+        return false;
+    }
+
+    if (2 != request->count || payload[0] > payload[1])
+    {
+        answer_status(client, request, PROTO_BAD_ARGS);
+        return true;
+    }
+
+    size_t begin = payload[0];
+    size_t end = payload[1];
+    size_t span = end - begin;
+
+    size_t limit = PROTO_RANGE == request->op ? PROTO_MAX_RANGE
+        : PROTO_COUNT == request->op ? PROTO_MAX_COUNT_RANGE : PROTO_MAX_PMPR_RANGE;
+    if (span >= limit)
+    {
+        answer_status(client, request, PROTO_TOO_LARGE);
+        return true;
+    }
+
+    sliced_request_t *sliced = &client->sliced;
+    sliced->request = *request;
+    sliced->next = begin;
+    sliced->end = end;
+    sliced->count = 0;
+    sliced->active = true;
+
+    return true;
+}
+
+
+static void answer_is_prime(connection_t *client, const proto_request_t *request, const uint64_t *numbers)
+{
+    proto_response_t response = {
+        .op = request->op,
+        .status = PROTO_OK,
+        .tag = request->tag,
+        .count = request->count
+    };
+    buffer_append(&client->out, &response, sizeof(response));
+    buffer_reserve(&client->out, request->count * sizeof(uint8_t));
+
+    /* results are placed right into the output buffer, numbers are copied out for alignment */
+    size_t batch[PROTO_MAX_BATCH / 16];
+    bool *primes = (bool*) (client->out.data + client->out.end);
+
+    for (size_t i = 0; i < request->count; i += sizeof(batch) / sizeof(batch[0]))
+    {
+        size_t left = request->count - i;
+        size_t size = left < sizeof(batch) / sizeof(batch[0]) ? left : sizeof(batch) / sizeof(batch[0]);
+
+        memcpy(batch, &numbers[i], size * sizeof(size_t));
+        are_primes_cached(batch, size, &primes[i]);
+    }
+
+    client->out.end += request->count * sizeof(uint8_t);
+}
+
+
+static void answer_slice(connection_t *client)
+{
+    sliced_request_t *sliced = &client->sliced;
+    size_t slice = RANGE_SLICE;
+    if (PROTO_PMPR == sliced->request.op && PMPR_SLICE_WORK / RANGE_SLICE < sliced->next)
+    {
+        slice = PMPR_SLICE_WORK / sliced->next + 1;
+    }
+    size_t high = sliced->end - sliced->next < slice ? sliced->end : sliced->next + slice - 1;
+
+    switch (sliced->request.op)
+    {
+        case PROTO_RANGE: slice_range(sliced, sliced->next, high); break;
+        case PROTO_COUNT: slice_count(sliced, sliced->next, high); break;
+        case PROTO_PMPR: slice_pmpr(sliced, sliced->next, high); break;
+    }
+
+    if (high < sliced->end)
+    {
+        sliced->next = high + 1;
+        return;
+    }
+
+    proto_response_t response = {
+        .op = sliced->request.op,
+        .status = PROTO_OK,
+        .tag = sliced->request.tag,
+        .count = sliced->count
+    };
+
+    /* amount of primes is the only item of the answer */
+    if (PROTO_COUNT == sliced->request.op)
+    {
+        buffer_append(&sliced->results, &sliced->count, sizeof(uint64_t));
+        response.count = 1;
+    }
+
+    buffer_append(&client->out, &response, sizeof(response));
+    buffer_append(&client->out, sliced->results.data + sliced->results.begin, buffer_size(&sliced->results));
+
+    sliced->results.begin = sliced->results.end = 0;
+    sliced->active = false;
+
+    process_requests(client);
+}
+
+
+static bool has_slice(const connection_t *client)
+{
+    return client->sliced.active && buffer_size(&client->out) < MAX_PENDING_OUTPUT;
+}
+
+
+static void slice_range(sliced_request_t *sliced, size_t begin, size_t end)
+{
+    dynarr_t *primes = create_primes_array();
+    get_primes_range(begin, end, &primes);
+
+    size_t count = dynarr_size(primes);
+    buffer_reserve(&sliced->results, count * sizeof(uint64_t));
+    for (size_t i = 0; i < count; ++i)
+    {
+        buffer_append(&sliced->results, dynarr_get(primes, i), sizeof(uint64_t));
+    }
+
+    sliced->count += count;
+    dynarr_destroy(primes);
+}
+
+
+static void slice_count(sliced_request_t *sliced, size_t begin, size_t end)
+{
+    sliced->count += count_primes_range(begin, end);
+}
+
+
+static void slice_pmpr(sliced_request_t *sliced, size_t begin, size_t end)
+{
+    dynarr_t *table = create_pair_array();
+    calc_PMPR_table(begin, end, &table);
+
+    size_t count = dynarr_size(table);
+    buffer_reserve(&sliced->results, count * 2 * sizeof(uint64_t));
+    for (size_t i = 0; i < count; ++i)
+    {
+        const pair_t *pair = (const pair_t*) dynarr_get(table, i);
+        uint64_t values[2] = { pair->first, pair->second };
+        buffer_append(&sliced->results, values, sizeof(values));
+    }
+
+    sliced->count += count;
+    dynarr_destroy(table);
+}
+
+
+static void answer_status(connection_t *client, const proto_request_t *request, proto_status_t status)
+{
+    proto_response_t response = {
+        .op = request->op,
+        .status = status,
+        .tag = request->tag,
+        .count = 0
+    };
+    buffer_append(&client->out, &response, sizeof(response));
+}
+
+
+static void buffer_reserve(buffer_t *buffer, size_t size)
+{
+    if (buffer->capacity - buffer->end >= size) return;
+
+    size_t capacity = buffer->capacity ? buffer->capacity : READ_CHUNK_SIZE;
+    while (capacity - buffer->end < size) capacity *= 2;
+
+    char *data = (char*) realloc(buffer->data, capacity);
+    if (NULL == data) exit(EXIT_FAILURE);
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+
+static void buffer_append(buffer_t *buffer, const void *data, size_t size)
+{
+    buffer_reserve(buffer, size);
+    memcpy(buffer->data + buffer->end, data, size);
+    buffer->end += size;
+}
+
+
+static size_t buffer_size(const buffer_t *buffer)
+{
+    return buffer->end - buffer->begin;
+}
+
+
+static void buffer_free(buffer_t *buffer)
+{
+    free(buffer->data);
+    *buffer = (buffer_t){};
+}
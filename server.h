@@ -0,0 +1,19 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+/*
+* Serves queries of protocol.h on a Unix socket at `socket_path` until `server_stop` is called.
+* Cache has to be initialized by `init_cache`, the server is its only user:
+* all connections are multiplexed by a single thread, so misses are computed once
+* and every client sees the same warm cache. Range operations are computed in slices
+* interleaved with requests of other clients, so a large one does not stall them.
+*/
+void server_run(const char *socket_path);
+
+/*
+* Makes `server_run` return, safe to call from a signal handler or another thread.
+*/
+void server_stop(void);
+
+
+#endif/*_SERVER_H_*/
@@ -0,0 +1,87 @@
+#include "sidecar.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+
+
+bool sidecar_open(sidecar_t *sidecar, const char *filename, uint64_t magic,
+    size_t unit, size_t count, size_t entry_size, bool writable)
+{
+    sidecar->map = NULL;
+    sidecar->fd = open(filename, writable ? O_RDWR|O_CREAT : O_RDONLY, S_IRUSR|S_IWUSR);
+    if (-1 == sidecar->fd)
+    {
+        if (!writable) return false;
+        exit(EXIT_FAILURE);
+    }
+
+    /* sparse, entries of units never touched take no space */
+    sidecar->map_size = SIDECAR_HEADER_SIZE + count * entry_size;
+
+    struct stat st;
+    if (-1 == fstat(sidecar->fd, &st)) exit(EXIT_FAILURE);
+
+    bool created = 0 == st.st_size;
+    if (created && !writable)
+    {
+        /* writer has not initialized it yet */
+        sidecar_close(sidecar);
+        return false;
+    }
+    if (created && -1 == ftruncate(sidecar->fd, sidecar->map_size)) exit(EXIT_FAILURE);
+
+    void *map = mmap(NULL,
+        sidecar->map_size,
+        writable ? PROT_READ|PROT_WRITE : PROT_READ,
+        MAP_SHARED,
+        sidecar->fd,
+        0
+    );
+    if (MAP_FAILED == map) exit(EXIT_FAILURE);
+
+    sidecar->map = (char*) map;
+    sidecar_header_t *header = (sidecar_header_t*) map;
+
+    if (created)
+    {
+        header->unit = unit;
+        header->count = count;
+        __atomic_store_n(&header->magic, magic, __ATOMIC_RELEASE);
+    }
+
+    /* written by a writer with different page size, or not initialized yet */
+    if (magic != __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE)
+        || header->unit != unit
+        || header->count != count)
+    {
+        if (writable) exit(EXIT_FAILURE);
+
+        sidecar_close(sidecar);
+        return false;
+    }
+
+    return true;
+}
+
+
+void sidecar_close(sidecar_t *sidecar)
+{
+    if (sidecar->map) munmap(sidecar->map, sidecar->map_size);
+    if (-1 != sidecar->fd) close(sidecar->fd);
+
+    sidecar->map = NULL;
+    sidecar->fd = -1;
+}
+
+
+void sidecar_sync(const void *addr, size_t length)
+{
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t) addr & ~(page_size - 1);
+    uintptr_t last = (uintptr_t) addr + length;
+
+    if (-1 == msync((void*) first, last - first, MS_SYNC)) exit(EXIT_FAILURE);
+}
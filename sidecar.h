@@ -0,0 +1,51 @@
+#ifndef _SIDECAR_H_
+#define _SIDECAR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+* Sidecar file of a cache file (`primes.dat.N.state`, `primes.dat.N.pages`):
+* a header page followed by fixed size entries, one per unit of the cache file.
+* Writer maps it read-write and creates it, readers map it read-only
+* once the writer has initialized the header.
+*/
+typedef struct sidecar_header
+{
+    uint64_t  magic;
+    uint64_t  unit;       /* bytes of the cache file per entry */
+    uint64_t  count;      /* amount of entries following the header */
+}
+sidecar_header_t;
+
+/*
+* Header takes its own page, so entries stay aligned.
+*/
+#define SIDECAR_HEADER_SIZE 4096
+
+typedef struct sidecar
+{
+    int       fd;
+    size_t    map_size;
+    char      *map;       /* header followed by entries */
+}
+sidecar_t;
+
+/*
+* Maps (and when `writable` creates) sidecar `filename` of `count` entries of `entry_size`
+* bytes, each for `unit` bytes of the cache file. Header of a created file is initialized
+* with `magic`, the rest of it is zero. Returns false if a reader opens a file
+* which does not exist or is not initialized yet, writer exits on a foreign file.
+*/
+bool sidecar_open(sidecar_t *sidecar, const char *filename, uint64_t magic,
+    size_t unit, size_t count, size_t entry_size, bool writable);
+void sidecar_close(sidecar_t *sidecar);
+
+/*
+* Writes `length` mapped bytes of a sidecar at `addr` to the file before return.
+*/
+void sidecar_sync(const void *addr, size_t length);
+
+
+#endif/*_SIDECAR_H_*/
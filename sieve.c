@@ -0,0 +1,447 @@
+#include "sieve.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#define WORD_BITS 64
+
+/*
+* Amount of odd numbers processed per segment.
+* 32 KiB of bits, so the segment stays in L1 data cache while being crossed out.
+*/
+#define SEGMENT_BITS (1ul << 18)
+
+/*
+* Width of windows of odd numbers sieved by `sieve_primes_between`.
+*/
+#define BETWEEN_WINDOW (1ul << 20)
+
+static void push_bucket(bucket_t *bucket, uint32_t prime, uint32_t index);
+
+static void clear_bit(uint64_t *bits, size_t idx);
+static void set_bit(uint64_t *bits, size_t idx);
+static bool test_bit(const uint64_t *bits, size_t idx);
+
+
+size_t sieve_odd_bitset_words(size_t limit)
+{
+    size_t odds = limit / 2;
+    return (odds + WORD_BITS - 1) / WORD_BITS;
+}
+
+
+void sieve_odd_bitset(uint64_t *bits, size_t limit)
+{
+    size_t odds = limit / 2;
+    size_t words = sieve_odd_bitset_words(limit);
+    if (0 == words) return;
+
+    /* base primes up to sqrt(limit), one byte per odd number */
+    size_t root = isqrt(limit);
+    size_t base_odds = root / 2 + 1;
+    char *composite = calloc(base_odds, 1);
+    size_t *primes = malloc(base_odds * sizeof(size_t));
+    size_t *next = malloc(base_odds * sizeof(size_t)); /* next odd index to cross out */
+    if (!composite || !primes || !next) exit(EXIT_FAILURE);
+
+    size_t count = 0;
+    for (size_t i = 1; i < base_odds; ++i)
+    {
+        size_t p = 2 * i + 1;
+        if (p > root) break;
+        if (composite[i]) continue;
+
+        primes[count] = p;
+        next[count] = p * p / 2;
+        ++count;
+
+        for (size_t j = p * p / 2; j < base_odds; j += p)
+        {
+            composite[j] = 1;
+        }
+    }
+
+    for (size_t low = 0; low < odds; low += SEGMENT_BITS)
+    {
+        size_t high = low + SEGMENT_BITS < odds ? low + SEGMENT_BITS : odds;
+        size_t first_word = low / WORD_BITS;
+        size_t last_word = (high + WORD_BITS - 1) / WORD_BITS;
+
+        memset(&bits[first_word], 0xff, (last_word - first_word) * sizeof(uint64_t));
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            size_t j = next[k];
+            for (; j < high; j += primes[k])
+            {
+                clear_bit(bits, j);
+            }
+            next[k] = j;
+        }
+    }
+
+    clear_bit(bits, 0); /* 1 is not a prime */
+
+    if (odds % WORD_BITS)
+    {
+        bits[words - 1] &= (1ul << (odds % WORD_BITS)) - 1;
+    }
+
+    free(next);
+    free(primes);
+    free(composite);
+}
+
+
+size_t isqrt(size_t number)
+{
+    size_t root = (size_t) sqrt((double) number);
+
+    while (root && root > number / root) --root;
+    while (root + 1 <= number / (root + 1)) ++root;
+
+    return root;
+}
+
+
+size_t *sieve_primes_upto(size_t limit, size_t *count)
+{
+    size_t words = sieve_odd_bitset_words(limit + 1);
+    uint64_t *bits = malloc((words ? words : 1) * sizeof(uint64_t));
+    if (NULL == bits) exit(EXIT_FAILURE);
+
+    sieve_odd_bitset(bits, limit + 1);
+
+    size_t total = limit >= 2 ? 1 : 0;
+    for (size_t i = 0; i < words; ++i)
+    {
+        total += __builtin_popcountl(bits[i]);
+    }
+
+    size_t *primes = malloc((total ? total : 1) * sizeof(size_t));
+    if (NULL == primes) exit(EXIT_FAILURE);
+
+    size_t n = 0;
+    if (limit >= 2) primes[n++] = 2;
+    for (size_t i = 1; n < total; ++i)
+    {
+        if (test_bit(bits, i)) primes[n++] = 2 * i + 1;
+    }
+
+    free(bits);
+    *count = total;
+    return primes;
+}
+
+
+void sieve_factor_window(size_t low, size_t count,
+    const size_t *primes, size_t primes_count, factorization_t *out)
+{
+    size_t *rest = malloc(count * sizeof(size_t)); /* part of the number not factored yet */
+    if (NULL == rest) exit(EXIT_FAILURE);
+
+    /* every number in the window is even */
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t number = low + 2 * i;
+        size_t power = __builtin_ctzl(number);
+
+        rest[i] = number >> power;
+        out[i].unique = 1;
+        out[i].total = power;
+        out[i].primes[0] = 2;
+    }
+
+    for (size_t k = 0; k < primes_count; ++k)
+    {
+        size_t prime = primes[k];
+        if (prime == 2) continue;
+
+        /* even multiples of an odd prime are 2 * prime apart, i.e. `prime` window slots */
+        size_t step = 2 * prime;
+        size_t first = (low + step - 1) / step * step;
+
+        for (size_t i = (first - low) / 2; i < count; i += prime)
+        {
+            factorization_t *f = &out[i];
+            f->primes[f->unique++] = prime;
+            do
+            {
+                rest[i] /= prime;
+                ++f->total;
+            }
+            while (rest[i] % prime == 0);
+        }
+    }
+
+    /* at most one factor above the square root remains */
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (rest[i] > 1)
+        {
+            out[i].primes[out[i].unique++] = rest[i];
+            ++out[i].total;
+        }
+    }
+
+    free(rest);
+}
+
+
+void sieve_odd_segment(size_t low, size_t count,
+    const size_t *primes, size_t primes_count, uint64_t *composite)
+{
+    size_t words = (count + WORD_BITS - 1) / WORD_BITS;
+    memset(composite, 0, words * sizeof(uint64_t));
+    if (0 == count) return;
+
+    size_t high = low + 2 * (count - 1);
+
+    for (size_t k = 0; k < primes_count; ++k)
+    {
+        size_t prime = primes[k];
+        if (prime == 2) continue;
+        if (prime > high / prime) break;
+
+        /* first odd multiple within the segment, primes below own square are not crossed */
+        size_t multiple = prime * prime;
+        if (multiple < low)
+        {
+            multiple = low / prime * prime;
+            if (multiple < low) multiple += prime;
+            if (multiple % 2 == 0) multiple += prime;
+        }
+
+        for (size_t j = (multiple - low) / 2; j < count; j += prime)
+        {
+            set_bit(composite, j);
+        }
+    }
+
+    if (low == 1) set_bit(composite, 0);
+}
+
+
+uint32_t *sieve_primes_between(size_t low, size_t high, size_t *count)
+{
+    size_t base_count;
+    size_t *base = sieve_primes_upto(isqrt(high), &base_count);
+
+    uint64_t *composite = malloc(BETWEEN_WINDOW / WORD_BITS * sizeof(uint64_t));
+    size_t capacity = 1024;
+    uint32_t *primes = malloc(capacity * sizeof(uint32_t));
+    if (!composite || !primes) exit(EXIT_FAILURE);
+
+    size_t total = 0;
+    if (low < 2 && high >= 2) primes[total++] = 2;
+
+    for (size_t first = (low + 1) | 1; first <= high; first += 2 * BETWEEN_WINDOW)
+    {
+        size_t window = (high - first) / 2 + 1;
+        if (window > BETWEEN_WINDOW) window = BETWEEN_WINDOW;
+
+        sieve_odd_segment(first, window, base, base_count, composite);
+
+        for (size_t i = 0; i < window; ++i)
+        {
+            if (test_bit(composite, i)) continue;
+
+            if (total == capacity)
+            {
+                capacity *= 2;
+                primes = realloc(primes, capacity * sizeof(uint32_t));
+                if (NULL == primes) exit(EXIT_FAILURE);
+            }
+            primes[total++] = first + 2 * i;
+        }
+    }
+
+    free(composite);
+    free(base);
+
+    *count = total;
+    return primes;
+}
+
+
+void bucket_sieve_init(bucket_sieve_t *sieve, size_t low, size_t count, size_t segments,
+    const uint32_t *primes, size_t primes_count)
+{
+    size_t largest = primes_count ? primes[primes_count - 1] : 0;
+
+    /* odd multiples are `prime` odd numbers apart, so the next one is at most that far ahead */
+    sieve->count = count;
+    sieve->segment = 0;
+    sieve->segments = segments;
+    sieve->ring = largest / count + 2;
+    sieve->buckets = calloc(sieve->ring, sizeof(bucket_t));
+    if (NULL == sieve->buckets) exit(EXIT_FAILURE);
+
+    sieve->low = low;
+    sieve->primes = primes;
+    sieve->primes_count = primes_count;
+    sieve->pending = primes_count;
+
+    for (size_t k = 0; k < primes_count; ++k)
+    {
+        size_t prime = primes[k];
+
+        /* primes are not crossed out below their squares, which ascend with primes */
+        if (prime * prime >= low)
+        {
+            sieve->pending = k;
+            break;
+        }
+
+        /* distance to the first odd multiple, which may not fit below 2^64 */
+        size_t distance = (prime - low % prime) % prime;
+        if (distance % 2) distance += prime;
+
+        size_t offset = distance / 2;
+        if (offset / count >= segments) continue;
+
+        push_bucket(&sieve->buckets[offset / count], prime, offset % count);
+    }
+}
+
+
+void bucket_sieve_free(bucket_sieve_t *sieve)
+{
+    for (size_t i = 0; i < sieve->ring; ++i)
+    {
+        free(sieve->buckets[i].entries);
+    }
+    free(sieve->buckets);
+    sieve->buckets = NULL;
+}
+
+
+void bucket_sieve_extend(bucket_sieve_t *sieve, const uint32_t *primes, size_t primes_count)
+{
+    size_t largest = primes_count ? primes[primes_count - 1] : 0;
+    size_t ring = largest / sieve->count + 2;
+
+    if (ring > sieve->ring)
+    {
+        bucket_t *buckets = calloc(ring, sizeof(bucket_t));
+        if (NULL == buckets) exit(EXIT_FAILURE);
+
+        /* bucket `i` holds the segment of the current ring turn congruent to it */
+        for (size_t i = 0; i < sieve->ring; ++i)
+        {
+            size_t segment = sieve->segment + (i + sieve->ring - sieve->segment % sieve->ring) % sieve->ring;
+            buckets[segment % ring] = sieve->buckets[i];
+        }
+
+        free(sieve->buckets);
+        sieve->buckets = buckets;
+        sieve->ring = ring;
+    }
+
+    sieve->primes = primes;
+    sieve->primes_count = primes_count;
+}
+
+
+void bucket_sieve_next(bucket_sieve_t *sieve, uint64_t *composite)
+{
+    size_t count = sieve->count;
+
+    /* squares of pending primes entering the reach of the ring */
+    for (; sieve->pending < sieve->primes_count; ++sieve->pending)
+    {
+        size_t prime = sieve->primes[sieve->pending];
+        size_t offset = (prime * prime - sieve->low) / 2;
+
+        if (offset / count >= sieve->segments)
+        {
+            sieve->pending = sieve->primes_count;
+            break;
+        }
+        if (offset / count >= sieve->segment + sieve->ring - 1) break;
+
+        push_bucket(&sieve->buckets[offset / count % sieve->ring], prime, offset % count);
+    }
+
+    bucket_t *bucket = &sieve->buckets[sieve->segment % sieve->ring];
+
+    for (size_t i = 0; i < bucket->count; ++i)
+    {
+        size_t prime = bucket->entries[i].prime;
+        size_t index = bucket->entries[i].index;
+
+        for (; index < count; index += prime)
+        {
+            if (composite) set_bit(composite, index);
+        }
+
+        size_t segment = sieve->segment + index / count;
+        if (segment >= sieve->segments) continue;
+
+        push_bucket(&sieve->buckets[segment % sieve->ring], prime, index % count);
+    }
+
+    bucket->count = 0;
+    ++sieve->segment;
+}
+
+
+void sieve_odd_coprime(uint64_t *bits, size_t low, size_t count, const factorization_t *factors)
+{
+    size_t words = (count + WORD_BITS - 1) / WORD_BITS;
+    memset(bits, 0xff, words * sizeof(uint64_t));
+
+    size_t first_odd = 2 * low + 1;
+    for (size_t i = 0; i < factors->unique; ++i)
+    {
+        size_t factor = factors->primes[i];
+        if (factor == 2) continue;
+
+        /* odd multiples of the odd factor are 2 * factor apart, i.e. `factor` slots */
+        size_t multiple = (first_odd + factor - 1) / factor * factor;
+        if (multiple % 2 == 0) multiple += factor;
+
+        for (size_t j = (multiple - 1) / 2 - low; j < count; j += factor)
+        {
+            clear_bit(bits, j);
+        }
+    }
+
+    if (count % WORD_BITS)
+    {
+        bits[words - 1] &= (1ul << (count % WORD_BITS)) - 1;
+    }
+}
+
+
+static void push_bucket(bucket_t *bucket, uint32_t prime, uint32_t index)
+{
+    if (bucket->count == bucket->capacity)
+    {
+        bucket->capacity = bucket->capacity ? 2 * bucket->capacity : 64;
+        bucket->entries = realloc(bucket->entries, bucket->capacity * sizeof(bucket_entry_t));
+        if (NULL == bucket->entries) exit(EXIT_FAILURE);
+    }
+
+    bucket->entries[bucket->count++] = (bucket_entry_t){ .prime = prime, .index = index };
+}
+
+
+static void clear_bit(uint64_t *bits, size_t idx)
+{
+    bits[idx / WORD_BITS] &= ~(1ul << (idx % WORD_BITS));
+}
+
+
+static void set_bit(uint64_t *bits, size_t idx)
+{
+    bits[idx / WORD_BITS] |= 1ul << (idx % WORD_BITS);
+}
+
+
+static bool test_bit(const uint64_t *bits, size_t idx)
+{
+    return (bits[idx / WORD_BITS] >> (idx % WORD_BITS)) & 1;
+}
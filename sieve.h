@@ -0,0 +1,140 @@
+#ifndef _SIEVE_H_
+#define _SIEVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* Maximal amount of distinct prime factors of a 64-bit number,
+* product of the first 16 primes exceeds 2^64.
+*/
+#define MAX_UNIQUE_FACTORS 15
+
+/*
+* Prime factorization of a single number, distinct factors in ascending order.
+*/
+typedef struct factorization
+{
+    uint8_t   unique;   /* amount of distinct prime factors */
+    uint8_t   total;    /* amount of prime factors with multiplicity */
+    size_t    primes[MAX_UNIQUE_FACTORS];
+}
+factorization_t;
+
+/*
+* Segmented sieve of Eratosthenes over odd numbers only.
+* Bit `i` of `bits` is set when `2 * i + 1` is a prime, for every `2 * i + 1 < limit`,
+* all remaining bits are cleared.
+* `bits` has to hold at least (limit / 2) bits rounded up to a whole word.
+*/
+void sieve_odd_bitset(uint64_t *bits, size_t limit);
+
+/*
+* Number of 64-bit words required by `sieve_odd_bitset` for the `limit`.
+*/
+size_t sieve_odd_bitset_words(size_t limit);
+
+/*
+* Integer square root, rounded down.
+*/
+size_t isqrt(size_t number);
+
+/*
+* Returns all primes up to `limit` inclusive in ascending order, amount stored in `count`.
+* Array is allocated by the function, caller has to free it.
+*/
+size_t *sieve_primes_upto(size_t limit, size_t *count);
+
+/*
+* Factors every even number of the window low, low + 2, ..., low + 2 * (count - 1)
+* in one pass, crossing out multiples of each prime instead of trial dividing each number.
+* `low` has to be even and non-zero, `primes` has to contain all primes up to
+* square root of the window end in ascending order.
+* Factorization of (low + 2 * i) is stored in `out[i]`.
+*/
+void sieve_factor_window(size_t low, size_t count,
+    const size_t *primes, size_t primes_count, factorization_t *out);
+
+/*
+* Crosses out odd composites among `count` odd numbers low, low + 2, ..., using odd `primes`
+* in ascending order (2 is skipped if present). Bit `i` of `composite` is set when (low + 2 * i)
+* is a multiple of one of the primes other than the prime itself, or when it is 1.
+* Result is complete only if `primes` contain every prime up to square root of the last number.
+*/
+void sieve_odd_segment(size_t low, size_t count,
+    const size_t *primes, size_t primes_count, uint64_t *composite);
+
+/*
+* Returns primes of (low, high] as 32-bit numbers in ascending order, amount stored in `count`.
+* `high` must not exceed UINT32_MAX. Array is allocated by the function, caller has to free it.
+*/
+uint32_t *sieve_primes_between(size_t low, size_t high, size_t *count);
+
+/*
+* Bucket sieve (Oliveira e Silva) of large primes over consecutive segments of odd numbers.
+* A prime larger than a segment hits it at most once, so instead of visiting every prime
+* for every segment each one waits in the bucket of the segment holding its next odd multiple
+* and is moved to the bucket of the following one after crossing it out.
+* Buckets form a ring covering the distance of the largest prime,
+* primes enter it once their squares come within its reach.
+*/
+typedef struct bucket_entry
+{
+    uint32_t  prime;
+    uint32_t  index;    /* of the odd multiple within its segment */
+}
+bucket_entry_t;
+
+typedef struct bucket
+{
+    bucket_entry_t *entries;
+    size_t    count;
+    size_t    capacity;
+}
+bucket_t;
+
+typedef struct bucket_sieve
+{
+    size_t    count;    /* odd numbers per segment */
+    size_t    segment;  /* index of the current segment */
+    size_t    segments; /* amount of segments to sieve */
+    size_t    ring;     /* amount of buckets */
+    bucket_t  *buckets;
+    size_t    low;
+    const uint32_t *primes;
+    size_t    primes_count;
+    size_t    pending;  /* first prime not in the buckets yet */
+}
+bucket_sieve_t;
+
+/*
+* Prepares sieving of `segments` consecutive segments of `count` odd numbers from odd `low` on
+* by `primes` in ascending order.
+*/
+void bucket_sieve_init(bucket_sieve_t *sieve, size_t low, size_t count, size_t segments,
+    const uint32_t *primes, size_t primes_count);
+void bucket_sieve_free(bucket_sieve_t *sieve);
+
+/*
+* Continues the sieve with `primes` grown since, the ones it had are their prefix.
+* The ring is widened for the largest of them, new primes enter it as pending ones.
+*/
+void bucket_sieve_extend(bucket_sieve_t *sieve, const uint32_t *primes, size_t primes_count);
+
+/*
+* Sets bits of odd multiples of the primes within the current segment in `composite`
+* (same layout as `sieve_odd_segment`), moves on to the next segment.
+* NULL `composite` only skips the segment.
+*/
+void bucket_sieve_next(bucket_sieve_t *sieve, uint64_t *composite);
+
+/*
+* Sieve of odd numbers coprime to a number with given `factors`.
+* Bit `i` of `bits` is set when (2 * (low + i) + 1) has no common odd factor with it,
+* for i in [0, count). Even numbers are never coprime to an even number,
+* so only odd ones are represented.
+*/
+void sieve_odd_coprime(uint64_t *bits, size_t low, size_t count, const factorization_t *factors);
+
+
+#endif/*_SIEVE_H_*/
@@ -0,0 +1,205 @@
+#include "small_primes.h"
+
+#include <stdlib.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+* Final verdict for a number after all divisibility checks,
+* `survived` is true when none of the small primes divides it.
+*/
+static cache_value_t resolve_filtered(size_t number, bool survived);
+
+typedef void (*filter_batch_fn_t)(const size_t *numbers, size_t count, cache_value_t *out);
+
+static void filter_batch_scalar(const size_t *numbers, size_t count, cache_value_t *out);
+
+#if defined(__x86_64__)
+static void filter_batch_avx2(const size_t *numbers, size_t count, cache_value_t *out);
+static void filter_batch_avx512(const size_t *numbers, size_t count, cache_value_t *out);
+#endif
+
+/*
+* Table of small odd primes.
+*/
+static const small_prime_t s_small_primes[SMALL_PRIMES_COUNT] = SMALL_PRIMES_TABLE;
+
+/*
+* Wheel increments.
+*/
+static const uint8_t s_wheel_increments[WHEEL_SPOKES] = WHEEL_INCREMENTS;
+
+/*
+* Batch kernel picked for the running cpu.
+*/
+static filter_batch_fn_t s_filter_batch = filter_batch_scalar;
+
+
+void init_small_primes(void)
+{
+    if (set_filter_kernel(FILTER_KERNEL_AVX512)) return;
+    if (set_filter_kernel(FILTER_KERNEL_AVX2)) return;
+
+    set_filter_kernel(FILTER_KERNEL_SCALAR);
+}
+
+
+bool set_filter_kernel(filter_kernel_t kernel)
+{
+    switch (kernel)
+    {
+        case FILTER_KERNEL_SCALAR:
+            s_filter_batch = filter_batch_scalar;
+            return true;
+#if defined(__x86_64__)
+        case FILTER_KERNEL_AVX2:
+            __builtin_cpu_init();
+            if (!__builtin_cpu_supports("avx2")) return false;
+
+            s_filter_batch = filter_batch_avx2;
+            return true;
+        case FILTER_KERNEL_AVX512:
+            __builtin_cpu_init();
+            if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512dq")) return false;
+
+            s_filter_batch = filter_batch_avx512;
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+
+const small_prime_t *get_small_primes(void)
+{
+    return s_small_primes;
+}
+
+
+const uint8_t *get_wheel_increments(void)
+{
+    return s_wheel_increments;
+}
+
+
+cache_value_t small_primes_filter(size_t number)
+{
+    if (number == 1) return NOT_PRIME;
+
+    for (size_t i = 0; i < SMALL_PRIMES_COUNT; ++i)
+    {
+        const small_prime_t *sp = &s_small_primes[i];
+        if (number * sp->inverse <= sp->limit)
+        {
+            return number == sp->prime ? PRIME : NOT_PRIME;
+        }
+    }
+
+    return number < SMALL_PRIMES_LARGEST * SMALL_PRIMES_LARGEST ? PRIME : UNDEFINED;
+}
+
+
+void small_primes_filter_batch(const size_t *numbers, size_t count, cache_value_t *out)
+{
+    s_filter_batch(numbers, count, out);
+}
+
+
+static cache_value_t resolve_filtered(size_t number, bool survived)
+{
+    /* number may be one of the small primes itself */
+    if (number <= SMALL_PRIMES_LARGEST) return small_primes_filter(number);
+    if (!survived) return NOT_PRIME;
+
+    return number < SMALL_PRIMES_LARGEST * SMALL_PRIMES_LARGEST ? PRIME : UNDEFINED;
+}
+
+
+static void filter_batch_scalar(const size_t *numbers, size_t count, cache_value_t *out)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = small_primes_filter(numbers[i]);
+    }
+}
+
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+static void filter_batch_avx2(const size_t *numbers, size_t count, cache_value_t *out)
+{
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i number = _mm256_loadu_si256((const __m256i*) &numbers[i]);
+        __m256i number_hi = _mm256_srli_epi64(number, 32);
+        __m256i survived = _mm256_set1_epi64x(-1);
+
+        for (size_t k = 0; k < SMALL_PRIMES_COUNT; ++k)
+        {
+            const small_prime_t *sp = &s_small_primes[k];
+            __m256i inverse = _mm256_set1_epi64x(sp->inverse);
+            __m256i inverse_hi = _mm256_set1_epi64x(sp->inverse >> 32);
+
+            /* low 64 bits of number * inverse out of 32x32 multiplications */
+            __m256i cross = _mm256_add_epi64(
+                _mm256_mul_epu32(number_hi, inverse),
+                _mm256_mul_epu32(number, inverse_hi));
+            __m256i product = _mm256_add_epi64(
+                _mm256_mul_epu32(number, inverse),
+                _mm256_slli_epi64(cross, 32));
+
+            /* unsigned product > limit, via signed compare of sign flipped values */
+            __m256i above = _mm256_cmpgt_epi64(
+                _mm256_xor_si256(product, sign),
+                _mm256_set1_epi64x(sp->limit ^ (uint64_t) INT64_MIN));
+
+            survived = _mm256_and_si256(survived, above);
+            if (_mm256_testz_si256(survived, survived)) break;
+        }
+
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(survived));
+        for (size_t lane = 0; lane < 4; ++lane)
+        {
+            out[i + lane] = resolve_filtered(numbers[i + lane], (mask >> lane) & 1);
+        }
+    }
+
+    filter_batch_scalar(&numbers[i], count - i, &out[i]);
+}
+
+
+__attribute__((target("avx512f,avx512dq")))
+static void filter_batch_avx512(const size_t *numbers, size_t count, cache_value_t *out)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i number = _mm512_loadu_si512((const void*) &numbers[i]);
+        __mmask8 survived = 0xff;
+
+        for (size_t k = 0; survived && k < SMALL_PRIMES_COUNT; ++k)
+        {
+            const small_prime_t *sp = &s_small_primes[k];
+            __m512i product = _mm512_mullo_epi64(number, _mm512_set1_epi64(sp->inverse));
+            survived &= _mm512_cmpgt_epu64_mask(product, _mm512_set1_epi64(sp->limit));
+        }
+
+        for (size_t lane = 0; lane < 8; ++lane)
+        {
+            out[i + lane] = resolve_filtered(numbers[i + lane], (survived >> lane) & 1);
+        }
+    }
+
+    filter_batch_scalar(&numbers[i], count - i, &out[i]);
+}
+
+#endif
+
@@ -0,0 +1,74 @@
+#ifndef _SMALL_PRIMES_H_
+#define _SMALL_PRIMES_H_
+
+#include "primes.h"
+#include "small_primes_table.h" /* generated by gen_tables */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* Odd prime with its multiplicative inverse modulo 2^64,
+* `number` is divisible by `prime` exactly when (number * inverse) <= limit.
+* Replaces 64-bit division by a single multiplication.
+*/
+typedef struct small_prime
+{
+    uint64_t prime;
+    uint64_t inverse;
+    uint64_t limit;   /* UINT64_MAX / prime */
+}
+small_prime_t;
+
+/*
+* Batch filtering kernels.
+*/
+typedef enum filter_kernel
+{
+    FILTER_KERNEL_SCALAR,
+    FILTER_KERNEL_AVX2,
+    FILTER_KERNEL_AVX512
+}
+filter_kernel_t;
+
+/*
+* Selects the widest batch filtering kernel supported by the running cpu.
+*/
+void init_small_primes(void);
+
+/*
+* Switches batch filtering to `kernel`, returns false if the running cpu does not support it.
+*/
+bool set_filter_kernel(filter_kernel_t kernel);
+
+/*
+* Build-time generated table of SMALL_PRIMES_COUNT odd primes (3 .. SMALL_PRIMES_LARGEST)
+* in ascending order.
+*/
+const small_prime_t *get_small_primes(void);
+
+/*
+* Build-time generated increments of the WHEEL_MODULUS wheel.
+* Trial division candidates past the table are produced as:
+*   candidate = WHEEL_START, spoke = WHEEL_START_SPOKE;
+*   candidate += increments[spoke], spoke = (spoke + 1) % WHEEL_SPOKES;
+*/
+const uint8_t *get_wheel_increments(void);
+
+/*
+* Cheap trial division of odd `number` by the small primes.
+* Returns NOT_PRIME when a divisor was found,
+* PRIME when no divisor was found and number is below square of the largest small prime,
+* UNDEFINED when the number survived, but primerility is still unknown.
+*/
+cache_value_t small_primes_filter(size_t number);
+
+/*
+* Batch version of `small_primes_filter` for `count` odd numbers, result of each stored in `out`.
+* Tests 8 (AVX-512) or 4 (AVX2) candidates at once, implementation is selected at runtime
+* by `init_small_primes` with scalar fallback.
+*/
+void small_primes_filter_batch(const size_t *numbers, size_t count, cache_value_t *out);
+
+
+#endif/*_SMALL_PRIMES_H_*/
@@ -0,0 +1,218 @@
+#include "stats.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+* Counters of a single thread, linked into the list of live threads.
+*/
+typedef struct stats_block
+{
+    stats_t   stats;        /* first member, `s_thread_stats` points here */
+    struct stats_block *prev;
+    struct stats_block *next;
+}
+stats_block_t;
+
+/*
+* Folds counters of the exiting thread into `s_retired` and releases its block.
+*/
+static void retire_thread(void *param);
+static void create_key(void);
+static void add_stats(stats_t *to, const stats_t *from);
+
+_Thread_local stats_t *s_thread_stats;
+
+/*
+* Set by `stats_set_timing` from any thread, read by every lookup.
+*/
+static bool s_stats_timing;
+
+/*
+* Blocks of live threads and sum of finished ones, guarded by `s_lock`.
+*/
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static stats_block_t *s_blocks;
+static stats_t s_retired;
+
+static pthread_once_t s_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_key;
+
+static const char *s_counter_names[STATS_COUNTERS_TOTAL] = {
+    [STATS_LOOKUPS]              = "lookups",
+    [STATS_L1_HITS]              = "l1_hits",
+    [STATS_FILTER_HITS]          = "filter_hits",
+    [STATS_CACHE_HITS]           = "cache_hits",
+    [STATS_CACHE_MISSES]         = "cache_misses",
+    [STATS_PAGE_REMAPS]          = "page_remaps",
+    [STATS_FILE_SWITCHES]        = "file_switches",
+    [STATS_FILE_EXTENSIONS]      = "file_extensions",
+    [STATS_FILE_PREALLOCATIONS]  = "file_preallocations",
+    [STATS_IS_PRIME_NANOSECONDS] = "is_prime_ns",
+    [STATS_SEGMENTS_SIEVED]      = "segments_sieved",
+    [STATS_SEGMENTS_COMPLETE]    = "segments_complete",
+    [STATS_BLOCK_FILLS]          = "block_fills",
+    [STATS_SPARSE_RESULTS]       = "sparse_results",
+    [STATS_SPARSE_PROMOTIONS]    = "sparse_promotions",
+    [STATS_SEGMENTS_READ_AHEAD]  = "segments_read_ahead",
+    [STATS_SEGMENTS_FROZEN]      = "segments_frozen",
+    [STATS_SEGMENTS_THAWED]      = "segments_thawed",
+    [STATS_BUCKETS_RESUMED]      = "buckets_resumed",
+};
+
+static const char *s_histogram_names[STATS_HISTOGRAMS_TOTAL] = {
+    [STATS_LOOKUP_LATENCY] = "lookup_latency",
+    [STATS_MISS_LATENCY]   = "miss_latency",
+};
+
+
+static void create_key(void)
+{
+    if (0 != pthread_key_create(&s_key, retire_thread)) exit(EXIT_FAILURE);
+}
+
+
+stats_t *stats_register_thread(void)
+{
+    if (s_thread_stats) return s_thread_stats;
+
+    pthread_once(&s_key_once, create_key);
+
+    stats_block_t *block = (stats_block_t*) calloc(1, sizeof(stats_block_t));
+    if (NULL == block) exit(EXIT_FAILURE);
+
+    pthread_mutex_lock(&s_lock);
+    block->next = s_blocks;
+    if (s_blocks) s_blocks->prev = block;
+    s_blocks = block;
+    pthread_mutex_unlock(&s_lock);
+
+    /* destructor runs only for non-NULL values, main thread keeps its block until exit */
+    pthread_setspecific(s_key, block);
+
+    s_thread_stats = &block->stats;
+    return s_thread_stats;
+}
+
+
+uint64_t stats_clock(void)
+{
+    if (!__atomic_load_n(&s_stats_timing, __ATOMIC_RELAXED)) return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ul + now.tv_nsec;
+}
+
+
+uint64_t stats_record(stats_histogram_t histogram, uint64_t started)
+{
+    if (!__atomic_load_n(&s_stats_timing, __ATOMIC_RELAXED) || 0 == started) return 0;
+
+    uint64_t elapsed = stats_clock() - started;
+    size_t bucket = elapsed ? 63 - __builtin_clzl(elapsed) : 0;
+
+    stats_t *stats = stats_register_thread();
+    __atomic_fetch_add(&stats->histograms[histogram][bucket], 1, __ATOMIC_RELAXED);
+    return elapsed;
+}
+
+
+void stats_set_timing(bool enabled)
+{
+    __atomic_store_n(&s_stats_timing, enabled, __ATOMIC_RELAXED);
+}
+
+
+void stats_get(stats_t *out)
+{
+    pthread_mutex_lock(&s_lock);
+
+    *out = s_retired;
+    for (stats_block_t *block = s_blocks; block; block = block->next)
+    {
+        add_stats(out, &block->stats);
+    }
+
+    pthread_mutex_unlock(&s_lock);
+}
+
+
+void stats_reset(void)
+{
+    pthread_mutex_lock(&s_lock);
+
+    memset(&s_retired, 0, sizeof(s_retired));
+    for (stats_block_t *block = s_blocks; block; block = block->next)
+    {
+        uint64_t *values = (uint64_t*) &block->stats;
+        for (size_t i = 0; i < sizeof(stats_t) / sizeof(uint64_t); ++i)
+        {
+            __atomic_store_n(&values[i], 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_mutex_unlock(&s_lock);
+}
+
+
+void stats_dump(FILE *file)
+{
+    stats_t stats;
+    stats_get(&stats);
+
+    for (size_t i = 0; i < STATS_COUNTERS_TOTAL; ++i)
+    {
+        fprintf(file, "%-20s %" PRIu64 "\n", s_counter_names[i], stats.counters[i]);
+    }
+
+    for (size_t h = 0; h < STATS_HISTOGRAMS_TOTAL; ++h)
+    {
+        for (size_t b = 0; b < STATS_HISTOGRAM_BUCKETS; ++b)
+        {
+            if (0 == stats.histograms[h][b]) continue;
+            fprintf(file, "%-20s >= %" PRIu64 " ns: %" PRIu64 "\n", s_histogram_names[h],
+                UINT64_C(1) << b, stats.histograms[h][b]);
+        }
+    }
+}
+
+
+const char *stats_counter_name(stats_counter_t counter)
+{
+    return s_counter_names[counter];
+}
+
+
+static void retire_thread(void *param)
+{
+    stats_block_t *block = (stats_block_t*) param;
+
+    pthread_mutex_lock(&s_lock);
+
+    add_stats(&s_retired, &block->stats);
+
+    if (block->prev) block->prev->next = block->next;
+    else s_blocks = block->next;
+    if (block->next) block->next->prev = block->prev;
+
+    pthread_mutex_unlock(&s_lock);
+
+    s_thread_stats = NULL;
+    free(block);
+}
+
+
+static void add_stats(stats_t *to, const stats_t *from)
+{
+    uint64_t *sum = (uint64_t*) to;
+    const uint64_t *values = (const uint64_t*) from;
+
+    for (size_t i = 0; i < sizeof(stats_t) / sizeof(uint64_t); ++i)
+    {
+        sum[i] += __atomic_load_n(&values[i], __ATOMIC_RELAXED);
+    }
+}
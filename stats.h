@@ -0,0 +1,112 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+* Event counters of the cache.
+*/
+typedef enum stats_counter
+{
+    STATS_LOOKUPS,          /* queries of is_prime_cached and are_primes_cached */
+    STATS_L1_HITS,          /* answered by the in-RAM bitset */
+    STATS_FILTER_HITS,      /* answered by the small primes filter */
+    STATS_CACHE_HITS,       /* answered by a defined cell of the cache file */
+    STATS_CACHE_MISSES,     /* cell was undefined, calculated by is_prime */
+    STATS_PAGE_REMAPS,      /* page of the cache mapped by open_page */
+    STATS_FILE_SWITCHES,    /* cache file changed by change_file */
+    STATS_FILE_EXTENSIONS,  /* cache file grown by ftruncate */
+    STATS_FILE_PREALLOCATIONS, /* extents of cache files allocated ahead of the range engine */
+    STATS_IS_PRIME_NANOSECONDS, /* spent in is_prime on misses, timing only */
+    STATS_SEGMENTS_SIEVED,  /* segments of the range engine filled by the sieve */
+    STATS_SEGMENTS_COMPLETE,/* segments of the range engine found complete */
+    STATS_BLOCK_FILLS,      /* pages or segments sieved on a cache miss */
+    STATS_SPARSE_RESULTS,   /* misses stored to the sparse store instead of the cache file */
+    STATS_SPARSE_PROMOTIONS,/* pages switched from the sparse store to the cache file */
+    STATS_SEGMENTS_READ_AHEAD, /* segments prepared by the read-ahead worker */
+    STATS_SEGMENTS_FROZEN,  /* segments moved to the cold tier */
+    STATS_SEGMENTS_THAWED,  /* segments restored from the cold tier */
+    STATS_BUCKETS_RESUMED,  /* runs of the range engine continuing buckets of the previous one */
+    STATS_COUNTERS_TOTAL
+}
+stats_counter_t;
+
+/*
+* Latency histograms, collected only when timing is enabled.
+*/
+typedef enum stats_histogram
+{
+    STATS_LOOKUP_LATENCY,   /* lookups answered by the cache file */
+    STATS_MISS_LATENCY,     /* lookups which had to call is_prime */
+    STATS_HISTOGRAMS_TOTAL
+}
+stats_histogram_t;
+
+/*
+* Bucket `i` of a histogram counts events which took [2^i, 2^(i+1)) nanoseconds.
+*/
+#define STATS_HISTOGRAM_BUCKETS 64
+
+typedef struct stats
+{
+    uint64_t  counters[STATS_COUNTERS_TOTAL];
+    uint64_t  histograms[STATS_HISTOGRAMS_TOTAL][STATS_HISTOGRAM_BUCKETS];
+}
+stats_t;
+
+/*
+* Counters of the calling thread, registered on first use and cleared when the thread retires.
+* Each thread adds only to its own block, blocks are summed up by `stats_get`.
+*/
+extern _Thread_local stats_t *s_thread_stats;
+
+stats_t *stats_register_thread(void);
+
+static inline void stats_add(stats_counter_t counter, uint64_t value)
+{
+    stats_t *stats = s_thread_stats;
+    if (__builtin_expect(NULL == stats, 0)) stats = s_thread_stats = stats_register_thread();
+
+    /* uncontended, yet `stats_reset` may zero the block from another thread meanwhile */
+    __atomic_fetch_add(&stats->counters[counter], value, __ATOMIC_RELAXED);
+}
+
+/*
+* Monotonic time in nanoseconds when timing is enabled, 0 otherwise.
+*/
+uint64_t stats_clock(void);
+
+/*
+* Records event started at `started` (a result of `stats_clock`) into the `histogram`,
+* no-op when timing is disabled. Returns its duration.
+*/
+uint64_t stats_record(stats_histogram_t histogram, uint64_t started);
+
+/*
+* Enables latency histograms and timing of is_prime, disabled by default.
+*/
+void stats_set_timing(bool enabled);
+
+/*
+* Sums up counters of all threads, including finished ones, into `out`.
+* Values are collected while threads keep working, so they are not an atomic snapshot.
+*/
+void stats_get(stats_t *out);
+
+/*
+* Zeroes counters of all threads.
+*/
+void stats_reset(void);
+
+/*
+* Prints aggregated counters and non-empty histogram buckets.
+*/
+void stats_dump(FILE *file);
+
+const char *stats_counter_name(stats_counter_t counter);
+
+
+#endif/*_STATS_H_*/
@@ -3,6 +3,7 @@
 typedef struct pair { size_t first; size_t second; } pair_t
 pair_t pmpr_table[] = {
     {101, 51},
+    {103, 65},
     {107, 60},
     {109, 56},
     {113, 58},
@@ -11,20 +12,27 @@ pair_t pmpr_table[] = {
     {137, 70},
     {139, 88},
     {149, 75},
+    {151, 96},
     {157, 80},
     {163, 89},
+    {167, 101},
     {173, 87},
     {179, 99},
     {181, 91},
+    {191, 113},
     {193, 102},
     {197, 99},
     {199, 127},
     {211, 133},
     {223, 102},
     {227, 125},
+    {229, 116},
     {233, 118},
+    {239, 131},
     {241, 127},
+    {251, 136},
     {257, 130},
+    {263, 152},
     {269, 135},
     {271, 147},
     {277, 140},
@@ -32,26 +40,39 @@ pair_t pmpr_table[] = {
     {283, 162},
     {293, 147},
     {307, 157},
+    {311, 174},
+    {313, 159},
     {317, 159},
     {331, 201},
+    {337, 171},
     {347, 188},
     {349, 175},
     {353, 178},
+    {359, 206},
+    {367, 185},
     {373, 187},
     {379, 188},
+    {383, 212},
     {389, 195},
     {397, 200},
     {401, 207},
+    {409, 208},
     {419, 224},
     {421, 211},
+    {431, 224},
     {433, 219},
+    {439, 231},
     {443, 242},
     {449, 226},
+    {457, 235},
     {461, 231},
     {463, 231},
     {467, 253},
+    {479, 268},
     {487, 246},
     {491, 250},
+    {499, 264},
+    {503, 277},
     {509, 255},
     {521, 262},
     {523, 274},
@@ -64,6 +85,7 @@ pair_t pmpr_table[] = {
     {577, 292},
     {587, 315},
     {593, 298},
+    {599, 346},
     {601, 304},
     {607, 332},
     {613, 307},
@@ -71,19 +93,26 @@ pair_t pmpr_table[] = {
     {619, 322},
     {631, 303},
     {641, 322},
+    {643, 325},
+    {647, 353},
     {653, 327},
     {659, 354},
     {661, 331},
     {673, 339},
     {677, 339},
+    {683, 356},
     {691, 340},
     {701, 351},
     {709, 355},
+    {719, 396},
     {727, 378},
+    {733, 368},
     {739, 403},
+    {743, 397},
     {751, 412},
     {757, 379},
     {761, 382},
+    {769, 388},
     {773, 387},
     {787, 403},
     {797, 399},
@@ -93,22 +122,32 @@ pair_t pmpr_table[] = {
     {823, 420},
     {827, 454},
     {829, 415},
+    {839, 462},
     {853, 427},
     {857, 430},
     {859, 438},
+    {863, 455},
     {877, 439},
     {881, 448},
     {883, 428},
+    {887, 477},
     {907, 448},
+    {911, 489},
+    {919, 475},
     {929, 466},
     {937, 472},
     {941, 471},
     {947, 494},
     {953, 478},
     {967, 498},
+    {971, 526},
     {977, 490},
+    {983, 528},
     {991, 513},
+    {997, 505},
+    {1009, 511},
     {1013, 511},
     {1019, 538},
+    {1021, 516},
 };
 #endif/*_TEST_PMPR_1_H_*/
\ No newline at end of file